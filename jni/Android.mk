@@ -52,7 +52,11 @@ LOCAL_SRC_FILES := \
 	simavr/simavr/cores/sim_mega32u4.c \
 	simavr/examples/parts/ssd1306_virt.c \
 	jni.c \
-	arduboy_avr.c
+	arduboy_avr.c \
+	avr_timer4.c \
+	host_thread.c \
+	png_writer.c \
+	frame_intervals.c
 
 # Include JNI headers
 LOCAL_C_INCLUDES += \
@@ -19,11 +19,14 @@
 
 #include <time.h>
 #include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
 #include <sim_avr.h>
+#include <sim_core.h>
 #include <avr_eeprom.h>
 #include <avr_flash.h>
 #include <avr_watchdog.h>
@@ -42,13 +45,41 @@
 #include <ssd1306_virt.h>
 
 #include "arduboy_avr.h"
+#include "avr_timer4.h"
+#include "host_thread.h"
+#include "png_writer.h"
+#include "frame_intervals.h"
 
 #define AVR_FREQUENCY (500000)
 #define REFRESH_PERIOD_US (512000) // for 1/60 frame
+#define VRAM_SIZE (SSD1306_VIRT_PAGES * SSD1306_VIRT_COLUMNS)
+#define VRAM_STALE_FRAMES_MAX (4)
+#define CPU_FREQUENCY (16000000) // real clock of Arduboy, for speed ratio
+#define NSEC_PER_SEC (1000000000LL)
+
+#define HUD_GLYPH_W (3)
+#define HUD_GLYPH_H (5)
 
 #define RGB(r,g,b) (0xFF000000 | (uint8_t)(r) << 16 | (uint8_t)(g) << 8 | (uint8_t)(b))
 #define BLACK RGB(0, 0, 0)
 
+/* Power reduction registers of atmega32u4 (data space addresses) */
+#define PRR0 (0x64)
+#define PRR1 (0x65)
+#define PRR_VECTORS_MAX (5)
+
+enum prr_gate_e {
+	PRR_GATE_TWI = 0,
+	PRR_GATE_TIMER0,
+	PRR_GATE_TIMER1,
+	PRR_GATE_SPI,
+	PRR_GATE_ADC,
+	PRR_GATE_TIMER4,
+	PRR_GATE_TIMER3,
+	PRR_GATE_USART1,
+	PRR_GATE_COUNT,
+};
+
 static const struct button_info {
 	char port_name;
 	int port_idx;
@@ -72,12 +103,54 @@ static const ssd1306_wiring_t ssd1306_wiring =
 	.reset.pin = 7,
 };
 
+struct prr_gate {
+	avr_io_addr_t r_prr;
+	uint8_t bit;
+	bool is_gated;
+	avr_int_vector_t *vectors[PRR_VECTORS_MAX];
+	uint8_t vector_nums[PRR_VECTORS_MAX];
+};
+
 static struct arduboy_avr_mod_state {
+	/* Touched on every avr_run() round: keep them on the first cache line */
 	struct avr_t *avr;
+	bool yield;
+	/* Touched by display hooks and once per frame */
+	uint16_t vram_write_count;
+	int frame_write_count, vram_stale_frames;
 	ssd1306_t ssd1306;
-	bool yield, is_refresh_postpone;
-	uint8_t lumamap[OLED_HEIGHT_PX][OLED_WIDTH_PX];
-} mod_s;
+	uint8_t front_vram[SSD1306_VIRT_PAGES][SSD1306_VIRT_COLUMNS];
+	/* Performance statistics, summarised once per second */
+	struct {
+		int target_fps;
+		int64_t window_start_ns, busy_ns;
+		avr_cycle_count_t cycles, sleep_cycles;
+		int frames, window_dropped;
+		int64_t window_cpu_ns;	// host CPU time of the emulation thread, 0 until first loop
+		int window_migrations;
+		avr_cycle_count_t frame_sleep_cycles;
+		int power_stats[POWER_STAT_COUNT];	// summary of the last window
+		int64_t bench_stats[BENCH_STAT_COUNT];
+	} perf;
+	frame_intervals_t intervals[INTERVALS_COUNT];
+	struct {
+		bool is_enabled;
+		char text[HUD_LINES][HUD_COLUMNS + 1];
+	} hud;
+	int64_t startup_ns[STARTUP_STAGE_COUNT];
+	/* Peripherals that simavr's mega32u4 core lacks */
+	avr_timer4_t timer4;
+	/* Touched only when firmware writes PRR0/PRR1 */
+	avr_io_t prr_io;
+	struct prr_gate prr_gates[PRR_GATE_COUNT];
+	/* Last parsed .hex image, kept for the process while the file is unchanged */
+	struct {
+		char path[PATH_MAX];
+		struct stat st;
+		uint8_t *image;
+		uint32_t base, size;
+	} hex;
+} mod_s __attribute__((aligned(64)));
 
 typedef struct {
 	avr_t			core;
@@ -97,6 +170,21 @@ typedef struct {
 
 /*------------------------------------------------------------------------------------------------*/
 
+static const struct hud_glyph {
+	char c;
+	uint8_t rows[HUD_GLYPH_H]; // 3 bits per row, MSB is left
+} hud_font[] = {
+	{ '0', { 7, 5, 5, 5, 7 } }, { '1', { 2, 6, 2, 2, 7 } }, { '2', { 7, 1, 7, 4, 7 } },
+	{ '3', { 7, 1, 7, 1, 7 } }, { '4', { 5, 5, 7, 1, 1 } }, { '5', { 7, 4, 7, 1, 7 } },
+	{ '6', { 7, 4, 7, 5, 7 } }, { '7', { 7, 1, 1, 1, 1 } }, { '8', { 7, 5, 7, 5, 7 } },
+	{ '9', { 7, 5, 7, 1, 7 } }, { '.', { 0, 0, 0, 0, 2 } }, { '%', { 5, 1, 2, 4, 5 } },
+	{ 'C', { 7, 4, 4, 4, 7 } }, { 'D', { 6, 5, 5, 5, 6 } }, { 'F', { 7, 4, 6, 4, 4 } },
+	{ 'H', { 5, 5, 7, 5, 5 } }, { 'M', { 5, 7, 7, 5, 5 } }, { 'P', { 7, 5, 7, 4, 4 } },
+	{ 'S', { 7, 4, 7, 1, 7 } }, { 'U', { 5, 5, 5, 5, 7 } }, { 'X', { 5, 5, 2, 5, 5 } },
+};
+
+/*------------------------------------------------------------------------------------------------*/
+
 static void android_logger(avr_t * avr, const int level, const char * format, va_list ap)
 {
 	if (!avr || avr->log >= level) {
@@ -105,17 +193,16 @@ static void android_logger(avr_t * avr, const int level, const char * format, va
 	}
 }
 
-static void update_lumamap(struct ssd1306_t *ssd1306)
+/*
+The SSD1306 model writes into its own VRAM, which we treat as the back buffer.
+The renderer only reads front_vram, so a frame is never shown half transferred.
+*/
+static void latch_vram(struct ssd1306_t *ssd1306)
 {
-	for (int p = 0; p < SSD1306_VIRT_PAGES; p++) {
-		for (int c = 0; c < SSD1306_VIRT_COLUMNS; c++) {
-			uint8_t px_col = ssd1306->vram[p][c];
-			for (int y = 0; y < 8; y++) {
-				mod_s.lumamap[p * 8 + y][c] = px_col & 0x1;
-				px_col >>= 1;
-			}
-		}
-	}
+	memcpy(mod_s.front_vram, ssd1306->vram, sizeof(mod_s.front_vram));
+	ssd1306_set_flag(ssd1306, SSD1306_FLAG_DIRTY, 0);
+	mod_s.vram_write_count = 0;
+	mod_s.vram_stale_frames = 0;
 }
 
 static inline int get_fg_colour(uint8_t invert, float opacity)
@@ -134,57 +221,249 @@ static inline float contrast_to_opacity(uint8_t contrast)
 	return contrast / 512.0 + 0.5;
 }
 
-static void render_screen(int *pixels, struct ssd1306_t *ssd1306)
+static uint8_t get_frame_flags(struct ssd1306_t *ssd1306)
+{
+	return ssd1306_get_flag(ssd1306, SSD1306_FLAG_DISPLAY_ON) * FRAME_FLAG_DISPLAY_ON |
+			ssd1306_get_flag(ssd1306, SSD1306_FLAG_SEGMENT_REMAP_0) * FRAME_FLAG_SEGMENT_REMAP |
+			ssd1306_get_flag(ssd1306, SSD1306_FLAG_COM_SCAN_NORMAL) * FRAME_FLAG_COM_SCAN |
+			ssd1306_get_flag(ssd1306, SSD1306_FLAG_DISPLAY_INVERTED) * FRAME_FLAG_INVERTED |
+			mod_s.hud.is_enabled * FRAME_FLAG_HUD;
+}
+
+static void pack_frame(struct arduboy_frame *frame, struct ssd1306_t *ssd1306)
+{
+	memcpy(frame->vram, mod_s.front_vram, sizeof(frame->vram));
+	frame->flags = get_frame_flags(ssd1306);
+	frame->contrast = ssd1306->contrast_register;
+	memcpy(frame->hud_text, mod_s.hud.text, sizeof(frame->hud_text));
+}
+
+static inline uint16_t argb_to_rgb565(uint32_t argb)
+{
+	return (argb >> 8 & 0xF800) | (argb >> 5 & 0x07E0) | (argb >> 3 & 0x001F);
+}
+
+static inline uint8_t argb_to_luma(uint32_t argb)
+{
+	uint8_t r = argb >> 16, g = argb >> 8, b = argb;
+	return (306 * r + 601 * g + 117 * b) >> 10;
+}
+
+#define RENDER_PIXELS(type, fg, bg) \
+	do { \
+		type *p = (type *) pixels; \
+		type fg_px = (fg), bg_px = (bg); \
+		for (int y = orig_y; y >= 0 && y < OLED_HEIGHT_PX; y += vy) { \
+			const uint8_t *page = frame->vram[y / 8]; \
+			uint8_t mask = 1 << (y % 8); \
+			for (int x = orig_x; x >= 0 && x < OLED_WIDTH_PX; x += vx) { \
+				*p++ = (page[x] & mask) ? fg_px : bg_px; \
+			} \
+		} \
+	} while (0)
+
+static inline int64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline int64_t get_thread_cpu_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static const uint8_t *get_hud_glyph(char c)
+{
+	for (int i = 0; i < sizeof(hud_font) / sizeof(hud_font[0]); i++) {
+		if (hud_font[i].c == c) {
+			return hud_font[i].rows;
+		}
+	}
+	return NULL; // blank
+}
+
+static inline void put_pixel(void *pixels, enum pixel_format_e format, int x, int y, bool is_on)
+{
+	int idx = y * OLED_WIDTH_PX + x;
+	switch (format) {
+	case PIXEL_FORMAT_ARGB8888:
+		((uint32_t *) pixels)[idx] = is_on ? RGB(255, 255, 255) : BLACK;
+		break;
+	case PIXEL_FORMAT_RGB565:
+		((uint16_t *) pixels)[idx] = is_on ? 0xFFFF : 0x0000;
+		break;
+	case PIXEL_FORMAT_L8:
+		((uint8_t *) pixels)[idx] = is_on ? 0xFF : 0x00;
+		break;
+	default:
+		break;
+	}
+}
+
+/* Draw the HUD text over the top-left corner, on a black box for legibility */
+static void draw_hud(void *pixels, enum pixel_format_e format, const struct arduboy_frame *frame)
+{
+	for (int line = 0; line < HUD_LINES; line++) {
+		const char *text = frame->hud_text[line];
+		int len = strnlen(text, HUD_COLUMNS);
+		int top = line * (HUD_GLYPH_H + 1);
+		for (int y = top; y < top + HUD_GLYPH_H + 1; y++) {
+			for (int x = 0; x < len * (HUD_GLYPH_W + 1) + 1; x++) {
+				put_pixel(pixels, format, x, y, false);
+			}
+		}
+		for (int i = 0; i < len; i++) {
+			const uint8_t *rows = get_hud_glyph(text[i]);
+			if (!rows) {
+				continue;
+			}
+			int left = i * (HUD_GLYPH_W + 1) + 1;
+			for (int gy = 0; gy < HUD_GLYPH_H; gy++) {
+				for (int gx = 0; gx < HUD_GLYPH_W; gx++) {
+					if (rows[gy] & (1 << (HUD_GLYPH_W - 1 - gx))) {
+						put_pixel(pixels, format, left + gx, top + 1 + gy, true);
+					}
+				}
+			}
+		}
+	}
+}
+
+static void reset_perf_stats(void)
+{
+	mod_s.perf.window_start_ns = get_time_ns();
+	mod_s.perf.busy_ns = 0;
+	mod_s.perf.cycles = 0;
+	mod_s.perf.sleep_cycles = 0;
+	mod_s.perf.frames = 0;
+	mod_s.perf.window_cpu_ns = 0;
+	mod_s.perf.window_dropped = mod_s.intervals[INTERVALS_EMULATION].dropped;
+}
+
+static void update_perf_stats(int64_t start_ns, avr_cycle_count_t cycles)
 {
-	if (!ssd1306_get_flag(ssd1306, SSD1306_FLAG_DISPLAY_ON)) {
+	int64_t now_ns = get_time_ns();
+	mod_s.perf.busy_ns += now_ns - start_ns;
+	mod_s.perf.cycles += cycles;
+	mod_s.perf.frames++;
+	__atomic_fetch_add(&mod_s.perf.bench_stats[BENCH_STAT_CORE_NS], now_ns - start_ns,
+			__ATOMIC_RELAXED);
+	__atomic_fetch_add(&mod_s.perf.bench_stats[BENCH_STAT_CYCLES], cycles, __ATOMIC_RELAXED);
+	frame_intervals_add(&mod_s.intervals[INTERVALS_EMULATION], now_ns, true);
+	mod_s.perf.power_stats[POWER_STAT_FRAME_IDLE] =
+			cycles ? (int) (mod_s.perf.frame_sleep_cycles * 1000 / cycles) : 0;
+
+	int64_t window_ns = now_ns - mod_s.perf.window_start_ns;
+	if (window_ns < NSEC_PER_SEC) {
 		return;
 	}
+	int frames = mod_s.perf.frames;
+	avr_cycle_count_t total_cycles = mod_s.perf.cycles ? mod_s.perf.cycles : 1;
+	double fps = frames * (double) NSEC_PER_SEC / window_ns;
+	double speed = mod_s.perf.cycles * (double) NSEC_PER_SEC / CPU_FREQUENCY / window_ns;
+	int load = 100 - (int) (mod_s.perf.sleep_cycles * 100 / total_cycles);
+	double host_ms = mod_s.perf.busy_ns / 1000000.0 / frames;
 
+	/*
+	Host CPU per emulated second is what costs battery. It is measured on the
+	whole emulation thread, so time spent in Java counts and sleeping doesn't.
+	*/
+	int64_t cpu_ns = get_thread_cpu_ns();
+	int host_cpu_us = (int) ((cpu_ns - mod_s.perf.window_cpu_ns) / 1000 * CPU_FREQUENCY / total_cycles);
+	mod_s.perf.power_stats[POWER_STAT_GUEST_IDLE] =
+			(int) (mod_s.perf.sleep_cycles * 1000 / total_cycles);
+	mod_s.perf.power_stats[POWER_STAT_HOST_CPU_US] = host_cpu_us;
+
+	snprintf(mod_s.hud.text[0], HUD_COLUMNS + 1, "%.0fFPS %.2fX H%dMS",
+			fps, speed, host_cpu_us / 1000);
+	int migrations = host_thread_get_migrations();
+	snprintf(mod_s.hud.text[1], HUD_COLUMNS + 1, "CPU%d%% %.1fMS D%d M%d", load, host_ms,
+			mod_s.intervals[INTERVALS_EMULATION].dropped - mod_s.perf.window_dropped,
+			migrations - mod_s.perf.window_migrations);
+
+	reset_perf_stats();
+	mod_s.perf.window_cpu_ns = cpu_ns;
+	mod_s.perf.window_migrations = migrations;
+}
+
+static void end_startup_stage(enum startup_stage_e stage, int64_t *stage_ns)
+{
+	int64_t now_ns = get_time_ns();
+	mod_s.startup_ns[stage] = now_ns - *stage_ns;
+	*stage_ns = now_ns;
+}
+
+static void render_pixels(void *pixels, enum pixel_format_e format, const struct arduboy_frame *frame)
+{
 	// Apply vertical and horizontal display mirroring
 	int orig_x = 0, orig_y = 0;
 	int vx = 1, vy = 1;
-	if (ssd1306_get_flag(ssd1306, SSD1306_FLAG_SEGMENT_REMAP_0)) {
+	if (frame->flags & FRAME_FLAG_SEGMENT_REMAP) {
 		orig_x = OLED_WIDTH_PX - 1; vx = -1;
 	}
-	if (ssd1306_get_flag(ssd1306, SSD1306_FLAG_COM_SCAN_NORMAL)) {
+	if (frame->flags & FRAME_FLAG_COM_SCAN) {
 		orig_y = OLED_HEIGHT_PX - 1; vy = -1;
 	}
 	
 	// Setup drawing colour
-	int invert = ssd1306_get_flag (ssd1306, SSD1306_FLAG_DISPLAY_INVERTED);
-	float opacity = contrast_to_opacity(ssd1306->contrast_register);
+	int invert = frame->flags & FRAME_FLAG_INVERTED;
+	float opacity = contrast_to_opacity(frame->contrast);
 	int bg_color = get_bg_colour(invert, opacity);
 	int fg_color = get_fg_colour(invert, opacity);
 
 	// Render screen
-	for (int y = orig_y; y >= 0 && y < OLED_HEIGHT_PX; y += vy) {
-		for (int x = orig_x; x >= 0 && x < OLED_WIDTH_PX; x += vx) {
-			*pixels++ = mod_s.lumamap[y][x] ? fg_color : bg_color;
-		}
+	switch (format) {
+	case PIXEL_FORMAT_ARGB8888:
+		RENDER_PIXELS(uint32_t, fg_color, bg_color);
+		break;
+	case PIXEL_FORMAT_RGB565:
+		RENDER_PIXELS(uint16_t, argb_to_rgb565(fg_color), argb_to_rgb565(bg_color));
+		break;
+	case PIXEL_FORMAT_L8:
+		RENDER_PIXELS(uint8_t, argb_to_luma(fg_color), argb_to_luma(bg_color));
+		break;
+	default:
+		break;
+	}
+}
+
+/* Only reads the frame, so this may run on any thread */
+static void render_frame(const struct arduboy_frame *frame, void *pixels, enum pixel_format_e format)
+{
+	if (frame->flags & FRAME_FLAG_DISPLAY_ON) {
+		render_pixels(pixels, format, frame);
+	}
+	if (frame->flags & FRAME_FLAG_HUD) {
+		draw_hud(pixels, format, frame);
 	}
 }
 
 static void hook_ssd1306_write_data(struct avr_irq_t *irq, uint32_t value, void *param)
 {
 	ssd1306_t *ssd1306 = (ssd1306_t *) param;
-	if (ssd1306->di_pin == SSD1306_VIRT_DATA) {
-		bool is_timing;
-		if (mod_s.is_refresh_postpone) {
-			is_timing = ssd1306->cursor.page == SSD1306_VIRT_PAGES - 1 &&
-					ssd1306->cursor.column == SSD1306_VIRT_COLUMNS - 1;
-		} else {
-			is_timing = ssd1306->cursor.page == 0 && ssd1306->cursor.column == 0;
-		}
-		if (is_timing && ssd1306_get_flag(ssd1306, SSD1306_FLAG_DIRTY)) {
-			update_lumamap(ssd1306);
-			ssd1306_set_flag(ssd1306, SSD1306_FLAG_DIRTY, 0);
-		}
+	if (ssd1306->di_pin != SSD1306_VIRT_DATA) {
+		return;
+	}
+	mod_s.frame_write_count++;
+	if (mod_s.vram_write_count < VRAM_SIZE) {
+		mod_s.vram_write_count++;
+	}
+	// A full-screen transfer has completed when the cursor wraps to the origin
+	if (mod_s.vram_write_count >= VRAM_SIZE &&
+			ssd1306->cursor.page == 0 && ssd1306->cursor.column == 0) {
+		latch_vram(ssd1306);
 	}
 }
 
 static void dummy_sleep(avr_t *avr, avr_cycle_count_t how_long)
 {
-	// do nothing
+	// Don't sleep in real time, only account the idle cycles of the guest
+	mod_s.perf.sleep_cycles += how_long;
+	mod_s.perf.frame_sleep_cycles += how_long;
 }
 
 static avr_cycle_count_t refresh(
@@ -225,19 +504,151 @@ static inline avr_regbit_t get_tx_regbit(mcu_t *mcu)
 	return ret;
 }
 
+static void set_prr_gate(avr_t *avr, struct prr_gate *gate, bool is_gated)
+{
+	if (gate->is_gated == is_gated) {
+		return;
+	}
+	for (int i = 0; i < PRR_VECTORS_MAX; i++) {
+		avr_int_vector_t *vector = gate->vectors[i];
+		if (!vector) {
+			break;
+		}
+		if (is_gated) {
+			/* A queued vector 0 would be serviced as a jump to reset */
+			if (avr_is_interrupt_pending(avr, vector)) {
+				avr_clear_interrupt(avr, vector);
+			}
+			vector->vector = _VECTOR(0);
+		} else {
+			vector->vector = gate->vector_nums[i];
+		}
+	}
+	gate->is_gated = is_gated;
+}
+
+static void hook_prr_write(struct avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+	avr_core_watch_write(avr, addr, v);
+	for (int i = 0; i < PRR_GATE_COUNT; i++) {
+		struct prr_gate *gate = &mod_s.prr_gates[i];
+		if (gate->r_prr == addr) {
+			set_prr_gate(avr, gate, (v >> gate->bit) & 1);
+		}
+	}
+}
+
+static void prr_reset(struct avr_io_t *io)
+{
+	for (int i = 0; i < PRR_GATE_COUNT; i++) {
+		set_prr_gate(io->avr, &mod_s.prr_gates[i], false);
+	}
+}
+
+static void add_prr_gate(enum prr_gate_e gate_e, avr_io_addr_t r_prr, uint8_t bit,
+		avr_int_vector_t *v0, avr_int_vector_t *v1, avr_int_vector_t *v2,
+		avr_int_vector_t *v3, avr_int_vector_t *v4)
+{
+	struct prr_gate *gate = &mod_s.prr_gates[gate_e];
+	avr_int_vector_t *vectors[PRR_VECTORS_MAX] = { v0, v1, v2, v3, v4 };
+	gate->r_prr = r_prr;
+	gate->bit = bit;
+	gate->is_gated = false;
+	for (int i = 0; i < PRR_VECTORS_MAX; i++) {
+		gate->vectors[i] = vectors[i];
+		gate->vector_nums[i] = vectors[i] ? vectors[i]->vector : 0;
+	}
+}
+
+static void setup_power_reduction(avr_t *avr, mcu_t *mcu)
+{
+	/*
+	Arduboy2's bootPowerSaving() gates the clocks of ADC, TWI and USART1 via
+	PRR0/PRR1. A gated peripheral is frozen on real h/w, so we stop raising its
+	interrupts while gated. Vector numbers are captured here, after tuning, so
+	vectors disabled by tuning stay disabled when the gate is reopened.
+
+	PRUSB (PRR1 bit 7) is not gated. simavr's USB vectors live in the private
+	state of avr_usb.c, out of reach from here, and they are only raised by
+	a USB host attached to the simulator, which this emulator never does.
+	*/
+	add_prr_gate(PRR_GATE_TWI, PRR0, 7, &mcu->twi.twi, NULL, NULL, NULL, NULL);
+	add_prr_gate(PRR_GATE_TIMER0, PRR0, 5, &mcu->timer0.overflow,
+			&mcu->timer0.comp[AVR_TIMER_COMPA].interrupt,
+			&mcu->timer0.comp[AVR_TIMER_COMPB].interrupt, NULL, NULL);
+	add_prr_gate(PRR_GATE_TIMER1, PRR0, 3, &mcu->timer1.overflow, &mcu->timer1.icr,
+			&mcu->timer1.comp[AVR_TIMER_COMPA].interrupt,
+			&mcu->timer1.comp[AVR_TIMER_COMPB].interrupt,
+			&mcu->timer1.comp[AVR_TIMER_COMPC].interrupt);
+	add_prr_gate(PRR_GATE_SPI, PRR0, 2, &mcu->spi.spi, NULL, NULL, NULL, NULL);
+	add_prr_gate(PRR_GATE_ADC, PRR0, 0, &mcu->adc.adc, NULL, NULL, NULL, NULL);
+	add_prr_gate(PRR_GATE_TIMER4, PRR1, 4, &mod_s.timer4.vectors[TIMER4_EVENT_COMPA],
+			&mod_s.timer4.vectors[TIMER4_EVENT_COMPB],
+			&mod_s.timer4.vectors[TIMER4_EVENT_COMPD],
+			&mod_s.timer4.vectors[TIMER4_EVENT_OVERFLOW], NULL);
+	add_prr_gate(PRR_GATE_TIMER3, PRR1, 3, &mcu->timer3.overflow, &mcu->timer3.icr,
+			&mcu->timer3.comp[AVR_TIMER_COMPA].interrupt,
+			&mcu->timer3.comp[AVR_TIMER_COMPB].interrupt,
+			&mcu->timer3.comp[AVR_TIMER_COMPC].interrupt);
+	add_prr_gate(PRR_GATE_USART1, PRR1, 0, &mcu->uart1.rxc, &mcu->uart1.txc,
+			&mcu->uart1.udrc, NULL, NULL);
+
+	memset(&mod_s.prr_io, 0, sizeof(mod_s.prr_io));
+	mod_s.prr_io.kind = "prr";
+	mod_s.prr_io.reset = prr_reset;
+	avr_register_io(avr, &mod_s.prr_io);
+	avr_register_io_write(avr, PRR0, hook_prr_write, NULL);
+	avr_register_io_write(avr, PRR1, hook_prr_write, NULL);
+}
+
+static bool is_same_file(const struct stat *a, const struct stat *b)
+{
+	return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+			a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+static const uint8_t *load_hex_image(const char *hex_file_path, uint32_t *size, uint32_t *base)
+{
+	struct stat st;
+	if (stat(hex_file_path, &st) != 0) {
+		return NULL;
+	}
+	if (!mod_s.hex.image || strcmp(mod_s.hex.path, hex_file_path) != 0 ||
+			!is_same_file(&mod_s.hex.st, &st)) {
+		free(mod_s.hex.image);
+		mod_s.hex.image = NULL;
+		if (strlen(hex_file_path) >= sizeof(mod_s.hex.path)) {
+			return NULL;
+		}
+		mod_s.hex.image = read_ihex_file(hex_file_path, &mod_s.hex.size, &mod_s.hex.base);
+		if (!mod_s.hex.image) {
+			return NULL;
+		}
+		strcpy(mod_s.hex.path, hex_file_path);
+		mod_s.hex.st = st;
+	}
+	*size = mod_s.hex.size;
+	*base = mod_s.hex.base;
+	return mod_s.hex.image;
+}
+
 /*------------------------------------------------------------------------------------------------*/
 
 int arduboy_avr_setup(const char *hex_file_path, bool is_tuned)
 {
 	avr_global_logger_set(android_logger);
 	mod_s.avr = NULL;
+	memset(mod_s.startup_ns, 0, sizeof(mod_s.startup_ns));
+	int64_t stage_ns = get_time_ns();
 
 	avr_t *avr = avr_make_mcu_by_name("atmega32u4");
 	if (!avr) {
 		LOGE("Failed to make AVR\n");
 		return -1;
 	}
+	end_startup_stage(STARTUP_STAGE_MAKE_MCU, &stage_ns);
 	avr_init(avr);
+	end_startup_stage(STARTUP_STAGE_INIT, &stage_ns);
 
 	/*
 	BTN_A is wired to INT6 which defaults to level triggered.
@@ -252,18 +663,18 @@ int arduboy_avr_setup(const char *hex_file_path, bool is_tuned)
 	{
 		/* Load .hex and setup program counter */
 		uint32_t boot_base, boot_size;
-		uint8_t * boot = read_ihex_file(hex_file_path, &boot_size, &boot_base);
+		const uint8_t *boot = load_hex_image(hex_file_path, &boot_size, &boot_base);
 		if (!boot) {
 			avr_terminate(avr);
 			LOGE("Unable to load \"%s\"\n", hex_file_path);
 			return -1;
 		}
 		memcpy(avr->flash + boot_base, boot, boot_size);
-		free(boot);
 		avr->pc = boot_base;
 		/* end of flash, remember we are writing /code/ */
 		avr->codeend = avr->flashend;
 	}
+	end_startup_stage(STARTUP_STAGE_LOAD_HEX, &stage_ns);
 
 	/* more simulation parameters */
 	avr->log = LOG_DEBUG; // LOG_NONE
@@ -277,7 +688,20 @@ int arduboy_avr_setup(const char *hex_file_path, bool is_tuned)
 	ssd1306_connect(ssd1306, (ssd1306_wiring_t *) &ssd1306_wiring);
 	avr_irq_register_notify(ssd1306->irq + IRQ_SSD1306_SPI_BYTE_IN, hook_ssd1306_write_data, ssd1306);
 	avr_irq_register_notify(ssd1306->irq + IRQ_SSD1306_TWI_OUT, hook_ssd1306_write_data, ssd1306);
-	memset(mod_s.lumamap, 0, sizeof(mod_s.lumamap));
+	memset(mod_s.front_vram, 0, sizeof(mod_s.front_vram));
+	mod_s.vram_write_count = 0;
+	mod_s.vram_stale_frames = 0;
+	for (int i = 0; i < INTERVALS_COUNT; i++) {
+		frame_intervals_reset(&mod_s.intervals[i], mod_s.perf.target_fps);
+	}
+	reset_perf_stats();
+	memset(mod_s.perf.power_stats, 0, sizeof(mod_s.perf.power_stats));
+	memset(mod_s.perf.bench_stats, 0, sizeof(mod_s.perf.bench_stats));
+	memset(mod_s.hud.text, 0, sizeof(mod_s.hud.text));
+	end_startup_stage(STARTUP_STAGE_DISPLAY, &stage_ns);
+
+	/* Timer4 isn't modelled by the mega32u4 core */
+	avr_timer4_init(avr, &mod_s.timer4);
 
 	/* Setup display render timers */
 	avr_cycle_timer_register_usec(avr, REFRESH_PERIOD_US, refresh, NULL);
@@ -296,6 +720,9 @@ int arduboy_avr_setup(const char *hex_file_path, bool is_tuned)
 		mcu->timer3.comp[AVR_TIMER_COMPB].interrupt.vector = _VECTOR(0);
 	}
 
+	/* Stop raising interrupts of peripherals gated by PRR0/PRR1 */
+	setup_power_reduction(avr, mcu);
+
 	/* Clear LEDs */
 	avr_regbit_set(avr, mcu->timer1.comp[AVR_TIMER_COMPB].com_pin);
 	avr_regbit_set(avr, mcu->timer0.comp[AVR_TIMER_COMPA].com_pin);
@@ -304,6 +731,7 @@ int arduboy_avr_setup(const char *hex_file_path, bool is_tuned)
 	avr_regbit_set(avr, get_tx_regbit(mcu));
 
 	mod_s.avr = avr;
+	end_startup_stage(STARTUP_STAGE_PERIPHERALS, &stage_ns);
 	LOGI("Setup AVR\n");
 	return 0;
 }
@@ -328,9 +756,24 @@ bool arduboy_avr_set_eeprom(const char *p_array)
 	return true;
 }
 
-bool arduboy_avr_set_refresh_timing(bool is_postpone)
+bool arduboy_avr_set_hud(bool is_enabled)
+{
+	mod_s.hud.is_enabled = is_enabled;
+	return true;
+}
+
+bool arduboy_avr_set_fps(int fps)
 {
-	mod_s.is_refresh_postpone = is_postpone;
+	/* The pacer restarts here, so only measure from the next frame on */
+	for (int i = 0; i < INTERVALS_COUNT; i++) {
+		if (fps != mod_s.perf.target_fps) {
+			frame_intervals_reset(&mod_s.intervals[i], fps);
+		} else {
+			mod_s.intervals[i].last_ns = 0;
+		}
+	}
+	mod_s.perf.target_fps = fps;
+	reset_perf_stats();
 	return true;
 }
 
@@ -347,20 +790,128 @@ bool arduboy_avr_button_event(enum button_e btn_e, bool pressed)
 	return true;
 }
 
-bool arduboy_avr_loop(int *pixels)
+bool arduboy_avr_loop(void)
 {
 	avr_t *avr = mod_s.avr;
 	if (!avr) {
 		return false;
 	}
+	int64_t start_ns = get_time_ns();
+	avr_cycle_count_t start_cycle = avr->cycle;
+	if (!mod_s.perf.window_cpu_ns) {
+		mod_s.perf.window_cpu_ns = get_thread_cpu_ns();
+		mod_s.perf.window_migrations = host_thread_get_migrations();
+	}
+	host_thread_sample();
+	mod_s.perf.frame_sleep_cycles = 0;
 	mod_s.yield = false;
+	mod_s.frame_write_count = 0;
 	while (!mod_s.yield) {
 		int state = avr_run(avr);
 		if (state == cpu_Done || state == cpu_Crashed) {
 			return false;
 		}
 	}
-	render_screen(pixels, &mod_s.ssd1306);
+	/*
+	Games that update only part of the screen never complete a full transfer.
+	Latch their changes once the bus has been quiet for a whole frame, or after
+	a few frames at the latest.
+	*/
+	ssd1306_t *ssd1306 = &mod_s.ssd1306;
+	if (ssd1306_get_flag(ssd1306, SSD1306_FLAG_DIRTY) && (mod_s.frame_write_count == 0 ||
+			++mod_s.vram_stale_frames >= VRAM_STALE_FRAMES_MAX)) {
+		latch_vram(ssd1306);
+	}
+	update_perf_stats(start_ns, avr->cycle - start_cycle);
+	return true;
+}
+
+bool arduboy_avr_get_frame(struct arduboy_frame *frame)
+{
+	if (!mod_s.avr) {
+		return false;
+	}
+	int64_t start_ns = get_time_ns();
+	pack_frame(frame, &mod_s.ssd1306);
+	__atomic_fetch_add(&mod_s.perf.bench_stats[BENCH_STAT_PACK_NS],
+			get_time_ns() - start_ns, __ATOMIC_RELAXED);
+	return true;
+}
+
+bool arduboy_avr_render_frame(const struct arduboy_frame *frame, void *pixels, enum pixel_format_e format)
+{
+	if (format >= PIXEL_FORMAT_COUNT) {
+		return false;
+	}
+	int64_t start_ns = get_time_ns();
+	render_frame(frame, pixels, format);
+	/* Usually called on the presentation thread */
+	__atomic_fetch_add(&mod_s.perf.bench_stats[BENCH_STAT_RENDER_NS],
+			get_time_ns() - start_ns, __ATOMIC_RELAXED);
+	return true;
+}
+
+bool arduboy_avr_save_png(const struct arduboy_frame *frame, const char *path, int scale)
+{
+	uint8_t luma[OLED_HEIGHT_PX * OLED_WIDTH_PX];
+	memset(luma, 0, sizeof(luma));
+	render_frame(frame, luma, PIXEL_FORMAT_L8);
+	return png_write_gray1(path, luma, OLED_WIDTH_PX, OLED_HEIGHT_PX, scale);
+}
+
+bool arduboy_avr_get_power_stats(int *stats)
+{
+	if (!mod_s.avr) {
+		return false;
+	}
+	memcpy(stats, mod_s.perf.power_stats, sizeof(mod_s.perf.power_stats));
+	return true;
+}
+
+bool arduboy_avr_get_bench_stats(int64_t *stats)
+{
+	if (!mod_s.avr) {
+		return false;
+	}
+	for (int i = 0; i < BENCH_STAT_COUNT; i++) {
+		stats[i] = __atomic_load_n(&mod_s.perf.bench_stats[i], __ATOMIC_RELAXED);
+	}
+	return true;
+}
+
+bool arduboy_avr_get_startup_times(int64_t *stage_ns)
+{
+	if (!mod_s.avr) {
+		return false;
+	}
+	memcpy(stage_ns, mod_s.startup_ns, sizeof(mod_s.startup_ns));
+	return true;
+}
+
+bool arduboy_avr_restart_intervals(void)
+{
+	if (!mod_s.avr) {
+		return false;
+	}
+	mod_s.intervals[INTERVALS_EMULATION].last_ns = 0;
+	return true;
+}
+
+bool arduboy_avr_note_presented(bool is_continuous)
+{
+	if (!mod_s.avr) {
+		return false;
+	}
+	frame_intervals_add(&mod_s.intervals[INTERVALS_PRESENTATION], get_time_ns(), is_continuous);
+	return true;
+}
+
+bool arduboy_avr_get_frame_intervals(enum intervals_e intervals_e, int *stats)
+{
+	if (!mod_s.avr || intervals_e >= INTERVALS_COUNT) {
+		return false;
+	}
+	frame_intervals_get(&mod_s.intervals[intervals_e], stats);
 	return true;
 }
 
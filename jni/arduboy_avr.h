@@ -18,11 +18,15 @@
 
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <android/log.h>
 
 #define OLED_WIDTH_PX (128)
 #define OLED_HEIGHT_PX (64)
 
+#define HUD_LINES (2)
+#define HUD_COLUMNS (24)
+
 #define LOG_TAG "ArbyEmulator"
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN, LOG_TAG, __VA_ARGS__)
@@ -39,6 +43,32 @@ enum button_e {
 	BTN_COUNT,
 };
 
+enum pixel_format_e {
+	PIXEL_FORMAT_ARGB8888 = 0,
+	PIXEL_FORMAT_RGB565,
+	PIXEL_FORMAT_L8,
+	PIXEL_FORMAT_COUNT,
+};
+
+enum frame_flag_e {
+	FRAME_FLAG_DISPLAY_ON = 1,
+	FRAME_FLAG_SEGMENT_REMAP = 2,
+	FRAME_FLAG_COM_SCAN = 4,
+	FRAME_FLAG_INVERTED = 8,
+	FRAME_FLAG_HUD = 16,
+};
+
+/*
+ * Everything needed to render one frame, packed so that it can be handed from
+ * the emulation thread to a presentation thread as a plain byte array.
+ */
+struct arduboy_frame {
+	uint8_t vram[OLED_HEIGHT_PX / 8][OLED_WIDTH_PX];
+	uint8_t flags; // FRAME_FLAG_*
+	uint8_t contrast;
+	char hud_text[HUD_LINES][HUD_COLUMNS + 1];
+};
+
 enum led_e {
 	LED_RED = 0,
 	LED_GREEN,
@@ -48,11 +78,53 @@ enum led_e {
 	LED_COUNT,
 };
 
+enum power_stat_e {
+	POWER_STAT_FRAME_IDLE = 0,	// guest idle cycles in the last frame, per mille
+	POWER_STAT_GUEST_IDLE,		// guest idle cycles over the last second, per mille
+	POWER_STAT_HOST_CPU_US,		// host CPU microseconds per emulated second
+	POWER_STAT_COUNT,
+};
+
+/* Stages of arduboy_avr_setup(), timed for cold start analysis */
+enum startup_stage_e {
+	STARTUP_STAGE_MAKE_MCU = 0,	// avr_make_mcu_by_name()
+	STARTUP_STAGE_INIT,			// avr_init()
+	STARTUP_STAGE_LOAD_HEX,		// read_ihex_file() into flash
+	STARTUP_STAGE_DISPLAY,		// SSD1306 setup
+	STARTUP_STAGE_PERIPHERALS,	// timers, tuning, power reduction and LEDs
+	STARTUP_STAGE_COUNT,
+};
+
+/* Cumulative since setup, for benchmarking */
+enum bench_stat_e {
+	BENCH_STAT_CORE_NS = 0,	// host time running the core
+	BENCH_STAT_PACK_NS,		// host time packing frames
+	BENCH_STAT_RENDER_NS,	// host time rendering packed frames
+	BENCH_STAT_CYCLES,		// emulated cycles
+	BENCH_STAT_COUNT,
+};
+
+enum intervals_e {
+	INTERVALS_EMULATION = 0,	// between completions of arduboy_avr_loop()
+	INTERVALS_PRESENTATION,		// between frames presented by the caller
+	INTERVALS_COUNT,
+};
+
 int arduboy_avr_setup(const char *hex_file_path, bool is_tuned);
 bool arduboy_avr_get_eeprom(char *p_array);
 bool arduboy_avr_set_eeprom(const char *p_array);
-bool arduboy_avr_set_refresh_timing(bool is_postpone);
+bool arduboy_avr_set_hud(bool is_enabled);
+bool arduboy_avr_set_fps(int fps);
 bool arduboy_avr_button_event(enum button_e btn_e, bool pressed);
-bool arduboy_avr_loop(int *pixels);
+bool arduboy_avr_loop(void);
+bool arduboy_avr_get_frame(struct arduboy_frame *frame);
+bool arduboy_avr_render_frame(const struct arduboy_frame *frame, void *pixels, enum pixel_format_e format);
+bool arduboy_avr_save_png(const struct arduboy_frame *frame, const char *path, int scale);
+bool arduboy_avr_get_power_stats(int *stats);
+bool arduboy_avr_get_bench_stats(int64_t *stats);
+bool arduboy_avr_get_startup_times(int64_t *stage_ns);
+bool arduboy_avr_restart_intervals(void); // after a deliberate pause of the pacer
+bool arduboy_avr_note_presented(bool is_continuous);
+bool arduboy_avr_get_frame_intervals(enum intervals_e intervals_e, int *stats);
 bool arduboy_avr_get_led_state(int *leds);
 void arduboy_avr_teardown(void);
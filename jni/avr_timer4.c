@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+
+#include <sim_avr.h>
+#include <sim_core.h>
+#include <sim_io.h>
+#include <sim_regbit.h>
+#include <sim_interrupts.h>
+#include <sim_cycle_timers.h>
+
+#include "avr_timer4.h"
+
+/* Timer4 registers of atmega32u4 (data space addresses) */
+#define TIFR4	(0x39)
+#define PLLFRQ	(0x52)
+#define TIMSK4	(0x72)
+#define TCNT4	(0xBE)
+#define TC4H	(0xBF)
+#define TCCR4A	(0xC0)
+#define TCCR4B	(0xC1)
+#define TCCR4C	(0xC2)
+#define TCCR4D	(0xC3)
+#define OCR4A	(0xCF)
+#define OCR4B	(0xD0)
+#define OCR4C	(0xD1)
+#define OCR4D	(0xD2)
+
+#define OCF4D	(7)
+#define OCF4A	(6)
+#define OCF4B	(5)
+#define TOV4	(2)
+
+#define PWM4A	(1)	// TCCR4A
+#define PWM4B	(0)	// TCCR4A
+#define PWM4D	(0)	// TCCR4C
+#define PSR4	(6)	// TCCR4B
+#define CS4_MASK	(0x0F)
+#define WGM4_MASK	(0x03)
+#define PLLTM_SHIFT	(4)
+#define PLLTM_MASK	(0x03)
+
+#define TIMER4_MAX	(0x3FF)
+#define NO_EVENT	((avr_cycle_count_t) -1)
+
+static const struct {
+	uint8_t bit;
+	uint8_t vector;
+} timer4_events[TIMER4_EVENT_COUNT] = {
+	{ OCF4A, 38 },	// TIMER4_COMPA
+	{ OCF4B, 39 },	// TIMER4_COMPB
+	{ OCF4D, 40 },	// TIMER4_COMPD
+	{ TOV4,  41 },	// TIMER4_OVF
+};
+
+/*
+PLL postscaler factors selected by PLLTM, as timer ticks per CPU cycle.
+This assumes the 96MHz PLL output and 16MHz system clock of Arduboy.
+*/
+static const uint32_t pll_clock_muls[] = { 1, 6, 4, 3 };
+
+/*------------------------------------------------------------------------------------------------*/
+
+static inline uint16_t get_10bit(avr_t *avr, uint8_t low)
+{
+	return (avr->data[TC4H] & (TIMER4_MAX >> 8)) << 8 | low;
+}
+
+static inline avr_cycle_count_t get_period(avr_timer4_t *p)
+{
+	avr_cycle_count_t period = p->is_dual_slope ? p->top * 2 : p->top + 1;
+	return period ? period : 1;
+}
+
+static avr_cycle_count_t get_ticks(avr_t *avr, avr_timer4_t *p)
+{
+	if (!p->prescale) {
+		return 0;
+	}
+	return (avr->cycle - p->base_cycle) * p->clock_mul / p->prescale;
+}
+
+static uint16_t get_tcnt(avr_t *avr, avr_timer4_t *p)
+{
+	avr_cycle_count_t period = get_period(p);
+	avr_cycle_count_t pos = (p->tcnt_base + get_ticks(avr, p)) % period;
+	if (p->is_dual_slope && pos > p->top) {
+		pos = period - pos;
+	}
+	return pos;
+}
+
+/* Ticks from position "pos" until the counter next reaches "count" */
+static avr_cycle_count_t ticks_until(avr_timer4_t *p, avr_cycle_count_t pos, uint16_t count)
+{
+	avr_cycle_count_t period = get_period(p);
+	avr_cycle_count_t delta = (count + period - pos) % period;
+	if (delta == 0) {
+		delta = period;
+	}
+	if (p->is_dual_slope && count > 0 && count < p->top) {
+		avr_cycle_count_t down = (period - count + period - pos) % period;
+		if (down == 0) {
+			down = period;
+		}
+		if (down < delta) {
+			delta = down;
+		}
+	}
+	return delta;
+}
+
+/*
+Event ticks are kept for every event, but only those enabled in TIMSK4 get a
+cycle timer. Flags of masked events are set lazily by latch_flags().
+*/
+static avr_cycle_count_t next_event_cycle(avr_t *avr, avr_timer4_t *p)
+{
+	uint8_t timsk = avr->data[TIMSK4];
+	avr_cycle_count_t ticks = get_ticks(avr, p);
+	avr_cycle_count_t pos = (p->tcnt_base + ticks) % get_period(p);
+	avr_cycle_count_t next_tick = NO_EVENT;
+
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		p->event_tick[i] = NO_EVENT;
+		if (!p->prescale) {
+			continue;
+		}
+		if (i == TIMER4_EVENT_OVERFLOW) {
+			p->event_tick[i] = ticks + ticks_until(p, pos, 0);
+		} else if (p->ocr[i] <= p->top) {
+			p->event_tick[i] = ticks + ticks_until(p, pos, p->ocr[i]);
+		}
+		if ((timsk & (1 << timer4_events[i].bit)) && p->event_tick[i] < next_tick) {
+			next_tick = p->event_tick[i];
+		}
+	}
+	if (next_tick == NO_EVENT) {
+		return 0;
+	}
+	// Round up so that the event tick has been reached when the timer fires
+	return p->base_cycle + (next_tick * p->prescale + p->clock_mul - 1) / p->clock_mul;
+}
+
+/* Set the flags of events reached so far; masked ones only raise their TIFR4 bit */
+static void latch_flags(avr_t *avr, avr_timer4_t *p)
+{
+	avr_cycle_count_t ticks = get_ticks(avr, p);
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		if (p->event_tick[i] <= ticks) {
+			avr_raise_interrupt(avr, &p->vectors[i]);
+			p->event_tick[i] = NO_EVENT;
+		}
+	}
+}
+
+static avr_cycle_count_t timer4_event(avr_t *avr, avr_cycle_count_t when, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	latch_flags(avr, p);
+	return next_event_cycle(avr, p);
+}
+
+static void reschedule(avr_t *avr, avr_timer4_t *p)
+{
+	latch_flags(avr, p);
+	avr_cycle_timer_cancel(avr, timer4_event, p);
+	avr_cycle_count_t when = next_event_cycle(avr, p);
+	if (when) {
+		avr_cycle_timer_register(avr, when - avr->cycle, timer4_event, p);
+	}
+}
+
+/* Restart lazy evaluation from the current cycle with counter value "tcnt" */
+static void rebase(avr_t *avr, avr_timer4_t *p, uint16_t tcnt)
+{
+	latch_flags(avr, p);
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		p->event_tick[i] = NO_EVENT; // relative to the old base, recomputed by reschedule()
+	}
+	p->base_cycle = avr->cycle;
+	p->tcnt_base = tcnt;
+}
+
+static void reconfigure(avr_t *avr, avr_timer4_t *p)
+{
+	uint8_t cs = avr->data[TCCR4B] & CS4_MASK;
+	uint8_t plltm = (avr->data[PLLFRQ] >> PLLTM_SHIFT) & PLLTM_MASK;
+	bool is_pwm = (avr->data[TCCR4A] & (1 << PWM4A | 1 << PWM4B)) ||
+			(avr->data[TCCR4C] & (1 << PWM4D));
+	p->prescale = cs ? 1 << (cs - 1) : 0;
+	p->clock_mul = pll_clock_muls[plltm];
+	p->is_dual_slope = is_pwm && (avr->data[TCCR4D] & WGM4_MASK) == 1;
+}
+
+/*------------------------------------------------------------------------------------------------*/
+
+static uint8_t timer4_tcnt_read(avr_t *avr, avr_io_addr_t addr, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	uint16_t tcnt = get_tcnt(avr, p);
+	avr->data[TC4H] = tcnt >> 8;
+	avr->data[TCNT4] = tcnt;
+	return tcnt;
+}
+
+static void timer4_tcnt_write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	avr_core_watch_write(avr, addr, v);
+	rebase(avr, p, get_10bit(avr, v));
+	reschedule(avr, p);
+}
+
+static void timer4_ocr_write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	uint16_t ocr = get_10bit(avr, v);
+	avr_core_watch_write(avr, addr, v);
+	switch (addr) {
+	case OCR4A: p->ocr[TIMER4_EVENT_COMPA] = ocr; break;
+	case OCR4B: p->ocr[TIMER4_EVENT_COMPB] = ocr; break;
+	case OCR4D: p->ocr[TIMER4_EVENT_COMPD] = ocr; break;
+	case OCR4C:
+		rebase(avr, p, get_tcnt(avr, p));
+		p->top = ocr;
+		break;
+	}
+	reschedule(avr, p);
+}
+
+static void timer4_config_write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	uint16_t tcnt = get_tcnt(avr, p);
+	if (addr == TCCR4B && (v & (1 << PSR4))) {
+		v &= ~(1 << PSR4); // prescaler reset bit is cleared by h/w
+	}
+	avr_core_watch_write(avr, addr, v);
+	rebase(avr, p, tcnt);
+	reconfigure(avr, p);
+	reschedule(avr, p);
+}
+
+static void timer4_timsk_write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	latch_flags(avr, p);
+	avr_core_watch_write(avr, addr, v);
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		// Flags raised while masked become pending once enabled
+		if (avr_regbit_get(avr, p->vectors[i].enable) &&
+				avr_regbit_get(avr, p->vectors[i].raised)) {
+			avr_raise_interrupt(avr, &p->vectors[i]);
+		}
+	}
+	reschedule(avr, p);
+}
+
+static uint8_t timer4_tifr_read(avr_t *avr, avr_io_addr_t addr, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	reschedule(avr, p); // latches flags passed since the last access
+	return avr->data[TIFR4];
+}
+
+static void timer4_tifr_write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param)
+{
+	avr_timer4_t *p = (avr_timer4_t *) param;
+	latch_flags(avr, p); // so that writing 1 clears them too
+	uint8_t old[TIMER4_EVENT_COUNT];
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		old[i] = avr_regbit_get(avr, p->vectors[i].raised);
+	}
+	// All flags in TIFR4 are write-1-to-clear
+	avr_core_watch_write(avr, addr, v);
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		avr_clear_interrupt_if(avr, &p->vectors[i], old[i]);
+	}
+}
+
+static void timer4_reset(struct avr_io_t *io)
+{
+	avr_timer4_t *p = (avr_timer4_t *) io;
+	avr_t *avr = io->avr;
+	avr_cycle_timer_cancel(avr, timer4_event, p);
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		p->event_tick[i] = NO_EVENT; // nothing to latch into the cleared TIFR4
+	}
+	memset(p->ocr, 0, sizeof(p->ocr));
+	p->top = 0xFF;
+	avr->data[OCR4C] = 0xFF;
+	rebase(avr, p, 0);
+	reconfigure(avr, p);
+}
+
+/*------------------------------------------------------------------------------------------------*/
+
+void avr_timer4_init(avr_t *avr, avr_timer4_t *p)
+{
+	memset(p, 0, sizeof(*p));
+	p->io.kind = "timer4";
+	p->io.reset = timer4_reset;
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		avr_int_vector_t *vector = &p->vectors[i];
+		avr_regbit_t enable = AVR_IO_REGBIT(TIMSK4, timer4_events[i].bit);
+		avr_regbit_t raised = AVR_IO_REGBIT(TIFR4, timer4_events[i].bit);
+		vector->enable = enable;
+		vector->raised = raised;
+		vector->vector = timer4_events[i].vector;
+	}
+
+	avr_register_io(avr, &p->io);
+	for (int i = 0; i < TIMER4_EVENT_COUNT; i++) {
+		avr_register_vector(avr, &p->vectors[i]);
+	}
+
+	avr_register_io_read(avr, TCNT4, timer4_tcnt_read, p);
+	avr_register_io_write(avr, TCNT4, timer4_tcnt_write, p);
+	avr_register_io_write(avr, OCR4A, timer4_ocr_write, p);
+	avr_register_io_write(avr, OCR4B, timer4_ocr_write, p);
+	avr_register_io_write(avr, OCR4C, timer4_ocr_write, p);
+	avr_register_io_write(avr, OCR4D, timer4_ocr_write, p);
+	avr_register_io_write(avr, TCCR4A, timer4_config_write, p);
+	avr_register_io_write(avr, TCCR4B, timer4_config_write, p);
+	avr_register_io_write(avr, TCCR4C, timer4_config_write, p);
+	avr_register_io_write(avr, TCCR4D, timer4_config_write, p);
+	avr_register_io_write(avr, PLLFRQ, timer4_config_write, p);
+	avr_register_io_write(avr, TIMSK4, timer4_timsk_write, p);
+	avr_register_io_read(avr, TIFR4, timer4_tifr_read, p);
+	avr_register_io_write(avr, TIFR4, timer4_tifr_write, p);
+
+	timer4_reset(&p->io);
+}
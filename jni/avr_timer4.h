@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __AVR_TIMER4_H__
+#define __AVR_TIMER4_H__
+
+#include <stdbool.h>
+#include <sim_avr.h>
+#include <sim_interrupts.h>
+
+enum timer4_event_e {
+	TIMER4_EVENT_COMPA = 0,
+	TIMER4_EVENT_COMPB,
+	TIMER4_EVENT_COMPD,
+	TIMER4_EVENT_OVERFLOW,
+	TIMER4_EVENT_COUNT,
+};
+
+/*
+ * 10-bit high speed Timer/Counter4 of atmega32u4.
+ *
+ * TCNT4 is never ticked. The counter is kept as a value at a base cycle and
+ * evaluated on demand, and a cycle timer is only scheduled while one of its
+ * interrupts is enabled in TIMSK4. Flags of masked events are set when TIFR4 is
+ * accessed, from the same lazy tick count.
+ */
+typedef struct avr_timer4_t {
+	avr_io_t			io;
+	avr_int_vector_t	vectors[TIMER4_EVENT_COUNT];
+
+	uint32_t			clock_mul;	// timer clock ticks per CPU cycle
+	uint32_t			prescale;	// 0 while stopped
+	bool				is_dual_slope;
+	uint16_t			top;		// OCR4C
+	uint16_t			ocr[TIMER4_EVENT_OVERFLOW];	// OCR4A, OCR4B, OCR4D
+	uint16_t			tcnt_base;
+	avr_cycle_count_t	base_cycle;
+	avr_cycle_count_t	event_tick[TIMER4_EVENT_COUNT];	// next unlatched event, in ticks from base_cycle
+} avr_timer4_t;
+
+void avr_timer4_init(avr_t *avr, avr_timer4_t *p);
+
+#endif
@@ -21,6 +21,30 @@ extern "C" {
 #define com_obnsoft_arduboyemu_Native_BUTTON_B 5L
 #undef com_obnsoft_arduboyemu_Native_BUTTON_MAX
 #define com_obnsoft_arduboyemu_Native_BUTTON_MAX 6L
+#undef com_obnsoft_arduboyemu_Native_FRAME_SIZE
+#define com_obnsoft_arduboyemu_Native_FRAME_SIZE 1076L
+#undef com_obnsoft_arduboyemu_Native_CPU_ANY
+#define com_obnsoft_arduboyemu_Native_CPU_ANY -1L
+#undef com_obnsoft_arduboyemu_Native_CPU_FASTEST
+#define com_obnsoft_arduboyemu_Native_CPU_FASTEST -2L
+#undef com_obnsoft_arduboyemu_Native_INTERVALS_EMULATION
+#define com_obnsoft_arduboyemu_Native_INTERVALS_EMULATION 0L
+#undef com_obnsoft_arduboyemu_Native_INTERVALS_PRESENTATION
+#define com_obnsoft_arduboyemu_Native_INTERVALS_PRESENTATION 1L
+#undef com_obnsoft_arduboyemu_Native_INTERVAL_STAT_SAMPLES
+#define com_obnsoft_arduboyemu_Native_INTERVAL_STAT_SAMPLES 0L
+#undef com_obnsoft_arduboyemu_Native_INTERVAL_STAT_P50_US
+#define com_obnsoft_arduboyemu_Native_INTERVAL_STAT_P50_US 1L
+#undef com_obnsoft_arduboyemu_Native_INTERVAL_STAT_P95_US
+#define com_obnsoft_arduboyemu_Native_INTERVAL_STAT_P95_US 2L
+#undef com_obnsoft_arduboyemu_Native_INTERVAL_STAT_P99_US
+#define com_obnsoft_arduboyemu_Native_INTERVAL_STAT_P99_US 3L
+#undef com_obnsoft_arduboyemu_Native_INTERVAL_STAT_LATE
+#define com_obnsoft_arduboyemu_Native_INTERVAL_STAT_LATE 4L
+#undef com_obnsoft_arduboyemu_Native_INTERVAL_STAT_DROPPED
+#define com_obnsoft_arduboyemu_Native_INTERVAL_STAT_DROPPED 5L
+#undef com_obnsoft_arduboyemu_Native_INTERVAL_STATS_SIZE
+#define com_obnsoft_arduboyemu_Native_INTERVAL_STATS_SIZE 6L
 /*
  * Class:     com_obnsoft_arduboyemu_Native
  * Method:    setup
@@ -47,12 +71,44 @@ JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setEeprom
 
 /*
  * Class:     com_obnsoft_arduboyemu_Native
- * Method:    setRefreshTiming
+ * Method:    setHud
  * Signature: (Z)Z
  */
-JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setRefreshTiming
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setHud
   (JNIEnv *, jclass, jboolean);
 
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    setFps
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setFps
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    setThreadPriority
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setThreadPriority
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    setThreadAffinity
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setThreadAffinity
+  (JNIEnv *, jclass, jint);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getCoreMigrations
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_obnsoft_arduboyemu_Native_getCoreMigrations
+  (JNIEnv *, jclass);
+
 /*
  * Class:     com_obnsoft_arduboyemu_Native
  * Method:    buttonEvent
@@ -64,11 +120,91 @@ JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_buttonEvent
 /*
  * Class:     com_obnsoft_arduboyemu_Native
  * Method:    loop
- * Signature: ([I)Z
+ * Signature: ()Z
  */
 JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_loop
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getFrame
+ * Signature: ([B)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getFrame
+  (JNIEnv *, jclass, jbyteArray);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    renderRgb565
+ * Signature: ([B[S)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_renderRgb565
+  (JNIEnv *, jclass, jbyteArray, jshortArray);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    renderLuma
+ * Signature: ([B[B)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_renderLuma
+  (JNIEnv *, jclass, jbyteArray, jbyteArray);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    savePng
+ * Signature: ([BLjava/lang/String;I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_savePng
+  (JNIEnv *, jclass, jbyteArray, jstring, jint);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getPowerStats
+ * Signature: ([I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getPowerStats
   (JNIEnv *, jclass, jintArray);
 
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getBenchStats
+ * Signature: ([J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getBenchStats
+  (JNIEnv *, jclass, jlongArray);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getStartupTimes
+ * Signature: ([J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getStartupTimes
+  (JNIEnv *, jclass, jlongArray);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    restartIntervals
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_restartIntervals
+  (JNIEnv *, jclass);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    notePresented
+ * Signature: (Z)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_notePresented
+  (JNIEnv *, jclass, jboolean);
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getFrameIntervals
+ * Signature: (I[I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getFrameIntervals
+  (JNIEnv *, jclass, jint, jintArray);
+
 /*
  * Class:     com_obnsoft_arduboyemu_Native
  * Method:    getLedState
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "frame_intervals.h"
+
+#define NSEC_PER_SEC (1000000000LL)
+#define NSEC_PER_USEC (1000)
+
+void frame_intervals_reset(frame_intervals_t *p, int fps)
+{
+	memset(p, 0, sizeof(*p));
+	p->period_ns = (fps > 0) ? NSEC_PER_SEC / fps : 0;
+}
+
+/*
+An event that doesn't follow the previous one directly, such as the first
+frame after a pause, only restarts the measurement.
+*/
+void frame_intervals_add(frame_intervals_t *p, int64_t now_ns, bool is_continuous)
+{
+	int64_t last_ns = p->last_ns;
+	p->last_ns = now_ns;
+	if (!last_ns || !is_continuous) {
+		return;
+	}
+	int64_t interval_ns = now_ns - last_ns;
+	int64_t bucket = interval_ns / (FRAME_INTERVAL_BUCKET_US * NSEC_PER_USEC);
+	if (bucket >= FRAME_INTERVAL_BUCKETS) {
+		bucket = FRAME_INTERVAL_BUCKETS - 1;
+	}
+	p->buckets[bucket]++;
+	p->samples++;
+
+	int64_t period_ns = p->period_ns;
+	if (period_ns && interval_ns * 2 > period_ns * 3) {
+		p->late++;
+		p->dropped += (interval_ns + period_ns / 2) / period_ns - 1;
+	}
+}
+
+static int get_percentile_us(const frame_intervals_t *p, int percent)
+{
+	if (!p->samples) {
+		return 0;
+	}
+	uint32_t rank = ((uint64_t) p->samples * percent + 99) / 100;
+	uint32_t total = 0;
+	for (int i = 0; i < FRAME_INTERVAL_BUCKETS; i++) {
+		total += p->buckets[i];
+		if (total >= rank) {
+			return (i + 1) * FRAME_INTERVAL_BUCKET_US; // upper bound of the bucket
+		}
+	}
+	return FRAME_INTERVAL_BUCKETS * FRAME_INTERVAL_BUCKET_US;
+}
+
+void frame_intervals_get(const frame_intervals_t *p, int *stats)
+{
+	stats[INTERVAL_STAT_SAMPLES] = p->samples;
+	stats[INTERVAL_STAT_P50_US] = get_percentile_us(p, 50);
+	stats[INTERVAL_STAT_P95_US] = get_percentile_us(p, 95);
+	stats[INTERVAL_STAT_P99_US] = get_percentile_us(p, 99);
+	stats[INTERVAL_STAT_LATE] = p->late;
+	stats[INTERVAL_STAT_DROPPED] = p->dropped;
+}
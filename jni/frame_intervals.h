@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FRAME_INTERVALS_H__
+#define __FRAME_INTERVALS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define FRAME_INTERVAL_BUCKET_US (100)
+#define FRAME_INTERVAL_BUCKETS (1000) // up to 100ms, the last one takes anything longer
+
+enum interval_stat_e {
+	INTERVAL_STAT_SAMPLES = 0,
+	INTERVAL_STAT_P50_US,
+	INTERVAL_STAT_P95_US,
+	INTERVAL_STAT_P99_US,
+	INTERVAL_STAT_LATE,		// intervals longer than 1.5 periods
+	INTERVAL_STAT_DROPPED,	// periods missed by late intervals
+	INTERVAL_STAT_COUNT,
+};
+
+/*
+ * Histogram of the intervals between successive frame events, e.g. loop
+ * completions or presentations, with late and dropped frames judged against
+ * the target period.
+ */
+typedef struct frame_intervals_t {
+	int64_t period_ns;	// 0 when unpaced
+	int64_t last_ns;	// 0 while there is no previous event to measure from
+	uint32_t samples, late, dropped;
+	uint32_t buckets[FRAME_INTERVAL_BUCKETS];
+} frame_intervals_t;
+
+void frame_intervals_reset(frame_intervals_t *p, int fps);
+void frame_intervals_add(frame_intervals_t *p, int64_t now_ns, bool is_continuous);
+void frame_intervals_get(const frame_intervals_t *p, int *stats);
+
+#endif
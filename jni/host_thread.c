@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "arduboy_avr.h"
+#include "host_thread.h"
+
+#define CPUFREQ_PATH_FORMAT "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq"
+
+static struct host_thread_state {
+	pid_t tid;	// thread sampled last
+	int last_cpu;
+	int migrations;
+} host_s = { 0, -1, 0 };
+
+static long get_cpu_max_freq(int cpu)
+{
+	char path[64];
+	long freq = 0;
+	snprintf(path, sizeof(path), CPUFREQ_PATH_FORMAT, cpu);
+	FILE *fp = fopen(path, "r");
+	if (fp) {
+		if (fscanf(fp, "%ld", &freq) != 1) {
+			freq = 0;
+		}
+		fclose(fp);
+	}
+	return freq;
+}
+
+/*
+Collect the cores of the fastest cluster, or nothing if cpufreq isn't readable
+for every core. Offline cores may have no cpufreq node, and those are often the
+big ones, so a partial view would pin the thread to the LITTLE cluster for good.
+*/
+static int get_fastest_cpus(cpu_set_t *set, int cpu_count)
+{
+	long max_freq = 0;
+	int count = 0;
+	CPU_ZERO(set);
+	for (int cpu = 0; cpu < cpu_count && cpu < CPU_SETSIZE; cpu++) {
+		long freq = get_cpu_max_freq(cpu);
+		if (freq <= 0) {
+			CPU_ZERO(set);
+			return 0;
+		}
+		if (freq > max_freq) {
+			CPU_ZERO(set);
+			max_freq = freq;
+			count = 0;
+		}
+		if (freq == max_freq) {
+			CPU_SET(cpu, set);
+			count++;
+		}
+	}
+	return count;
+}
+
+bool host_thread_set_priority(int nice)
+{
+	pid_t tid = syscall(__NR_gettid);
+	if (setpriority(PRIO_PROCESS, tid, nice) < 0) {
+		LOGW("Failed to set priority %d: %s\n", nice, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+bool host_thread_set_affinity(int cpu)
+{
+	int cpu_count = sysconf(_SC_NPROCESSORS_CONF);
+	cpu_set_t set;
+	if (cpu == HOST_CPU_ANY) {
+		CPU_ZERO(&set);
+		for (int i = 0; i < cpu_count && i < CPU_SETSIZE; i++) {
+			CPU_SET(i, &set);
+		}
+	} else if (cpu == HOST_CPU_FASTEST) {
+		if (get_fastest_cpus(&set, cpu_count) == 0) {
+			LOGW("Unable to find the fastest cores\n");
+			return false;
+		}
+	} else if (cpu >= 0 && cpu < cpu_count && cpu < CPU_SETSIZE) {
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+	} else {
+		return false;
+	}
+	if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+		LOGW("Failed to set affinity %d: %s\n", cpu, strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+void host_thread_sample(void)
+{
+	int cpu = sched_getcpu();
+	if (cpu < 0) {
+		return;
+	}
+	pid_t tid = syscall(__NR_gettid);
+	if (tid != host_s.tid) {
+		host_s.tid = tid; // a new emulation thread hasn't migrated yet
+		host_s.last_cpu = -1;
+	}
+	if (host_s.last_cpu >= 0 && cpu != host_s.last_cpu) {
+		host_s.migrations++;
+	}
+	host_s.last_cpu = cpu;
+}
+
+int host_thread_get_migrations(void)
+{
+	return host_s.migrations;
+}
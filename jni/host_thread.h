@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HOST_THREAD_H__
+#define __HOST_THREAD_H__
+
+#include <stdbool.h>
+
+#define HOST_CPU_ANY (-1)		// no affinity
+#define HOST_CPU_FASTEST (-2)	// cores with the highest max frequency
+
+/*
+ * Scheduling controls for the calling host thread, which is meant to be the
+ * emulation thread. On big.LITTLE SoCs the scheduler otherwise migrates it
+ * between clusters and it loses its cache state each time.
+ */
+bool host_thread_set_priority(int nice);
+bool host_thread_set_affinity(int cpu);
+
+/* Called once per frame to count migrations between cores of the calling thread */
+void host_thread_sample(void);
+int host_thread_get_migrations(void);
+
+#endif
@@ -19,10 +19,22 @@
 
 #include <stdio.h>
 #include "arduboy_avr.h"
+#include "host_thread.h"
+#include "frame_intervals.h"
 #include "com_obnsoft_arduboyemu_Native.h"
 
 #define EEPROM_SIZE 1024
 
+_Static_assert(sizeof(struct arduboy_frame) == com_obnsoft_arduboyemu_Native_FRAME_SIZE,
+        "Native.FRAME_SIZE must match struct arduboy_frame");
+_Static_assert(HOST_CPU_ANY == com_obnsoft_arduboyemu_Native_CPU_ANY &&
+        HOST_CPU_FASTEST == com_obnsoft_arduboyemu_Native_CPU_FASTEST,
+        "Native.CPU_* must match HOST_CPU_*");
+_Static_assert(INTERVALS_EMULATION == com_obnsoft_arduboyemu_Native_INTERVALS_EMULATION &&
+        INTERVALS_PRESENTATION == com_obnsoft_arduboyemu_Native_INTERVALS_PRESENTATION &&
+        INTERVAL_STAT_COUNT == com_obnsoft_arduboyemu_Native_INTERVAL_STATS_SIZE,
+        "Native.INTERVAL* must match frame_intervals.h");
+
 /*
  * Class:     com_obnsoft_arduboyemu_Native
  * Method:    setup
@@ -81,13 +93,52 @@ JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setEeprom(
 
 /*
  * Class:     com_obnsoft_arduboyemu_Native
- * Method:    setRefreshTiming
+ * Method:    setHud
  * Signature: (Z)Z
  */
-JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setRefreshTiming(
-        JNIEnv *env, jclass obj, jboolean is_postpone) {
-    jboolean ret = arduboy_avr_set_refresh_timing(is_postpone);
-    return ret;
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setHud(
+        JNIEnv *env, jclass obj, jboolean is_enabled) {
+    return arduboy_avr_set_hud(is_enabled);
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    setFps
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setFps(
+        JNIEnv *env, jclass obj, jint fps) {
+    return arduboy_avr_set_fps(fps);
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    setThreadPriority
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setThreadPriority(
+        JNIEnv *env, jclass obj, jint nice) {
+    return host_thread_set_priority(nice);
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    setThreadAffinity
+ * Signature: (I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_setThreadAffinity(
+        JNIEnv *env, jclass obj, jint cpu) {
+    return host_thread_set_affinity(cpu);
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getCoreMigrations
+ * Signature: ()I
+ */
+JNIEXPORT jint JNICALL Java_com_obnsoft_arduboyemu_Native_getCoreMigrations(
+        JNIEnv *env, jclass obj) {
+    return host_thread_get_migrations();
 }
 
 /*
@@ -103,16 +154,205 @@ JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_buttonEvent(
 /*
  * Class:     com_obnsoft_arduboyemu_Native
  * Method:    loop
- * Signature: ([I)Z
+ * Signature: ()Z
  */
 JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_loop(
+        JNIEnv *env, jclass obj) {
+    return arduboy_avr_loop();
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getFrame
+ * Signature: ([B)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getFrame(
+        JNIEnv *env, jclass obj, jbyteArray jbyte_array) {
+    jboolean ret;
+    jbyte *p_array = (*env)->GetByteArrayElements(env, jbyte_array, &ret);
+    int array_len = (*env)->GetArrayLength(env, jbyte_array);
+
+    if (array_len >= sizeof(struct arduboy_frame)) {
+        ret = arduboy_avr_get_frame((struct arduboy_frame *) p_array);
+    } else {
+        ret = JNI_FALSE;
+    }
+
+    (*env)->ReleaseByteArrayElements(env, jbyte_array, p_array, 0);
+    return ret;
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    renderRgb565
+ * Signature: ([B[S)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_renderRgb565(
+        JNIEnv *env, jclass obj, jbyteArray jframe, jshortArray jshort_array) {
+    jboolean ret;
+    jbyte *p_frame = (*env)->GetByteArrayElements(env, jframe, &ret);
+    int frame_len = (*env)->GetArrayLength(env, jframe);
+    jshort *p_array = (*env)->GetShortArrayElements(env, jshort_array, &ret);
+    int array_len = (*env)->GetArrayLength(env, jshort_array);
+
+    if (frame_len >= sizeof(struct arduboy_frame) &&
+            array_len >= OLED_WIDTH_PX * OLED_HEIGHT_PX) {
+        ret = arduboy_avr_render_frame((const struct arduboy_frame *) p_frame,
+                p_array, PIXEL_FORMAT_RGB565);
+    } else {
+        ret = JNI_FALSE;
+    }
+
+    (*env)->ReleaseShortArrayElements(env, jshort_array, p_array, 0);
+    (*env)->ReleaseByteArrayElements(env, jframe, p_frame, JNI_ABORT);
+    return ret;
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    renderLuma
+ * Signature: ([B[B)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_renderLuma(
+        JNIEnv *env, jclass obj, jbyteArray jframe, jbyteArray jbyte_array) {
+    jboolean ret;
+    jbyte *p_frame = (*env)->GetByteArrayElements(env, jframe, &ret);
+    int frame_len = (*env)->GetArrayLength(env, jframe);
+    jbyte *p_array = (*env)->GetByteArrayElements(env, jbyte_array, &ret);
+    int array_len = (*env)->GetArrayLength(env, jbyte_array);
+
+    if (frame_len >= sizeof(struct arduboy_frame) &&
+            array_len >= OLED_WIDTH_PX * OLED_HEIGHT_PX) {
+        ret = arduboy_avr_render_frame((const struct arduboy_frame *) p_frame,
+                p_array, PIXEL_FORMAT_L8);
+    } else {
+        ret = JNI_FALSE;
+    }
+
+    (*env)->ReleaseByteArrayElements(env, jbyte_array, p_array, 0);
+    (*env)->ReleaseByteArrayElements(env, jframe, p_frame, JNI_ABORT);
+    return ret;
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    savePng
+ * Signature: ([BLjava/lang/String;I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_savePng(
+        JNIEnv *env, jclass obj, jbyteArray jframe, jstring js_path, jint scale) {
+    jboolean ret;
+    jbyte *p_frame = (*env)->GetByteArrayElements(env, jframe, &ret);
+    int frame_len = (*env)->GetArrayLength(env, jframe);
+    const char *path = (*env)->GetStringUTFChars(env, js_path, NULL);
+
+    if (frame_len >= sizeof(struct arduboy_frame)) {
+        ret = arduboy_avr_save_png((const struct arduboy_frame *) p_frame, path, scale);
+    } else {
+        ret = JNI_FALSE;
+    }
+
+    (*env)->ReleaseStringUTFChars(env, js_path, path);
+    (*env)->ReleaseByteArrayElements(env, jframe, p_frame, JNI_ABORT);
+    return ret;
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getPowerStats
+ * Signature: ([I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getPowerStats(
         JNIEnv *env, jclass obj, jintArray jint_array) {
     jboolean ret;
     jint *p_array = (*env)->GetIntArrayElements(env, jint_array, &ret);
     int array_len = (*env)->GetArrayLength(env, jint_array);
 
-    if (array_len >= OLED_WIDTH_PX * OLED_HEIGHT_PX) {
-        ret = arduboy_avr_loop(p_array);
+    if (array_len >= POWER_STAT_COUNT) {
+        ret = arduboy_avr_get_power_stats(p_array);
+    } else {
+        ret = JNI_FALSE;
+    }
+
+    (*env)->ReleaseIntArrayElements(env, jint_array, p_array, 0);
+    return ret;
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getBenchStats
+ * Signature: ([J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getBenchStats(
+        JNIEnv *env, jclass obj, jlongArray jlong_array) {
+    jboolean ret;
+    jlong *p_array = (*env)->GetLongArrayElements(env, jlong_array, &ret);
+    int array_len = (*env)->GetArrayLength(env, jlong_array);
+
+    if (array_len >= BENCH_STAT_COUNT) {
+        ret = arduboy_avr_get_bench_stats((int64_t *) p_array);
+    } else {
+        ret = JNI_FALSE;
+    }
+
+    (*env)->ReleaseLongArrayElements(env, jlong_array, p_array, 0);
+    return ret;
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getStartupTimes
+ * Signature: ([J)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getStartupTimes(
+        JNIEnv *env, jclass obj, jlongArray jlong_array) {
+    jboolean ret;
+    jlong *p_array = (*env)->GetLongArrayElements(env, jlong_array, &ret);
+    int array_len = (*env)->GetArrayLength(env, jlong_array);
+
+    if (array_len >= STARTUP_STAGE_COUNT) {
+        ret = arduboy_avr_get_startup_times((int64_t *) p_array);
+    } else {
+        ret = JNI_FALSE;
+    }
+
+    (*env)->ReleaseLongArrayElements(env, jlong_array, p_array, 0);
+    return ret;
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    restartIntervals
+ * Signature: ()Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_restartIntervals(
+        JNIEnv *env, jclass obj) {
+    return arduboy_avr_restart_intervals();
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    notePresented
+ * Signature: (Z)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_notePresented(
+        JNIEnv *env, jclass obj, jboolean is_continuous) {
+    return arduboy_avr_note_presented(is_continuous);
+}
+
+/*
+ * Class:     com_obnsoft_arduboyemu_Native
+ * Method:    getFrameIntervals
+ * Signature: (I[I)Z
+ */
+JNIEXPORT jboolean JNICALL Java_com_obnsoft_arduboyemu_Native_getFrameIntervals(
+        JNIEnv *env, jclass obj, jint which, jintArray jint_array) {
+    jboolean ret;
+    jint *p_array = (*env)->GetIntArrayElements(env, jint_array, &ret);
+    int array_len = (*env)->GetArrayLength(env, jint_array);
+
+    if (array_len >= INTERVAL_STAT_COUNT) {
+        ret = arduboy_avr_get_frame_intervals((enum intervals_e) which, p_array);
     } else {
         ret = JNI_FALSE;
     }
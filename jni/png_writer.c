@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "png_writer.h"
+
+#define PNG_SCALE_MAX (16)
+#define DEFLATE_STORED_MAX (65535)
+#define ADLER_MOD (65521)
+
+static const uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+static uint32_t crc_table[256];
+
+static void init_crc_table(void)
+{
+	for (uint32_t n = 0; n < 256; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++) {
+			c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+		}
+		crc_table[n] = c;
+	}
+}
+
+static uint32_t update_crc(uint32_t crc, const uint8_t *buf, size_t len)
+{
+	if (!crc_table[1]) {
+		init_crc_table();
+	}
+	for (size_t i = 0; i < len; i++) {
+		crc = crc_table[(crc ^ buf[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static uint32_t adler32(const uint8_t *buf, size_t len)
+{
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < len; i++) {
+		a = (a + buf[i]) % ADLER_MOD;
+		b = (b + a) % ADLER_MOD;
+	}
+	return b << 16 | a;
+}
+
+static inline uint8_t *put_be32(uint8_t *p, uint32_t v)
+{
+	*p++ = v >> 24; *p++ = v >> 16; *p++ = v >> 8; *p++ = v;
+	return p;
+}
+
+static bool write_chunk(FILE *fp, const char *type, const uint8_t *data, size_t len)
+{
+	uint8_t header[8], footer[4];
+	put_be32(header, len);
+	memcpy(header + 4, type, 4);
+	uint32_t crc = update_crc(0xFFFFFFFF, header + 4, 4);
+	crc = update_crc(crc, data, len) ^ 0xFFFFFFFF;
+	put_be32(footer, crc);
+	return fwrite(header, 1, 8, fp) == 8 &&
+			fwrite(data, 1, len, fp) == len &&
+			fwrite(footer, 1, 4, fp) == 4;
+}
+
+bool png_write_gray1(const char *path, const uint8_t *luma, int width, int height, int scale)
+{
+	if (scale < 1 || scale > PNG_SCALE_MAX) {
+		return false;
+	}
+	int out_w = width * scale, out_h = height * scale;
+	size_t stride = 1 + (out_w + 7) / 8; // filter type byte and packed pixels
+	size_t raw_len = stride * out_h;
+	size_t blocks = (raw_len + DEFLATE_STORED_MAX - 1) / DEFLATE_STORED_MAX;
+	size_t idat_len = 2 + blocks * 5 + raw_len + 4;
+
+	uint8_t *idat = malloc(idat_len);
+	uint8_t *raw = malloc(raw_len);
+	if (!idat || !raw) {
+		free(idat);
+		free(raw);
+		return false;
+	}
+
+	/* Pack the scanlines, filter type None */
+	memset(raw, 0, raw_len);
+	for (int y = 0; y < out_h; y++) {
+		uint8_t *row = raw + stride * y + 1;
+		const uint8_t *src = luma + (y / scale) * width;
+		for (int x = 0; x < out_w; x++) {
+			if (src[x / scale]) {
+				row[x / 8] |= 0x80 >> (x % 8);
+			}
+		}
+	}
+
+	/* zlib stream of stored deflate blocks */
+	uint8_t *p = idat;
+	*p++ = 0x78; *p++ = 0x01;
+	for (size_t pos = 0; pos < raw_len; pos += DEFLATE_STORED_MAX) {
+		size_t len = raw_len - pos;
+		if (len > DEFLATE_STORED_MAX) {
+			len = DEFLATE_STORED_MAX;
+		}
+		*p++ = (pos + len == raw_len); // BFINAL, BTYPE 00
+		*p++ = len; *p++ = len >> 8;
+		*p++ = ~len; *p++ = ~len >> 8;
+		memcpy(p, raw + pos, len);
+		p += len;
+	}
+	p = put_be32(p, adler32(raw, raw_len));
+	free(raw);
+
+	uint8_t ihdr[13];
+	put_be32(ihdr, out_w);
+	put_be32(ihdr + 4, out_h);
+	ihdr[8] = 1;	// bit depth
+	ihdr[9] = 0;	// greyscale
+	ihdr[10] = 0;	// deflate
+	ihdr[11] = 0;	// adaptive filtering
+	ihdr[12] = 0;	// no interlace
+
+	bool ret = false;
+	FILE *fp = fopen(path, "wb");
+	if (fp) {
+		ret = fwrite(png_signature, 1, sizeof(png_signature), fp) == sizeof(png_signature) &&
+				write_chunk(fp, "IHDR", ihdr, sizeof(ihdr)) &&
+				write_chunk(fp, "IDAT", idat, p - idat) &&
+				write_chunk(fp, "IEND", NULL, 0);
+		ret = (fclose(fp) == 0) && ret;
+		if (!ret) {
+			remove(path);
+		}
+	}
+	free(idat);
+	return ret;
+}
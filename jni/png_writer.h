@@ -0,0 +1,33 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PNG_WRITER_H__
+#define __PNG_WRITER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Write an 8-bit luminance image as a 1-bit greyscale PNG, non-zero pixels
+ * being white, enlarged by an integer scale. The image data is deflated with
+ * stored blocks only: a 1-bit frame is tiny, so compressing it isn't worth the
+ * time.
+ */
+bool png_write_gray1(const char *path, const uint8_t *luma, int width, int height, int scale);
+
+#endif
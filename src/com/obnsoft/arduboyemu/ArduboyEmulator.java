@@ -18,16 +18,16 @@
 
 package com.obnsoft.arduboyemu;
 
-import java.io.ByteArrayInputStream;
-import java.io.ByteArrayOutputStream;
 import java.io.File;
 import java.io.FileInputStream;
 import java.io.FileNotFoundException;
 import java.io.FileOutputStream;
 import java.io.IOException;
-import java.io.InputStream;
-import java.io.OutputStream;
+import java.util.Arrays;
 import java.util.Calendar;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.TimeUnit;
 
 import com.obnsoft.arduboyemu.Utils.CancelCallback;
 
@@ -37,6 +37,7 @@ import android.media.MediaScannerConnection;
 import android.os.Environment;
 import android.os.Handler;
 import android.text.format.DateFormat;
+import android.util.Log;
 
 public class ArduboyEmulator {
 
@@ -46,6 +47,8 @@ public class ArduboyEmulator {
 
     private static final int PIXELS_SIZE = SCREEN_WIDTH * SCREEN_HEIGHT;
 
+    private static final String LOG_TAG = "ArbyEmulator";
+
     private static final int LED_RED    = 0;
     private static final int LED_GREEN  = 1;
     private static final int LED_BLUE   = 2;
@@ -53,36 +56,65 @@ public class ArduboyEmulator {
     private static final int LED_TX     = 4;
     private static final int LEDS_SIZE  = 5;
 
+    private static final int POWER_STAT_FRAME_IDLE  = 0;
+    private static final int POWER_STAT_GUEST_IDLE  = 1;
+    private static final int POWER_STAT_HOST_CPU_US = 2;
+    private static final int POWER_STATS_SIZE       = 3;
+
     private static final int ONE_SECOND = 1000;
+    private static final int FRAME_QUEUE_SIZE = 3;
+    private static final int FRAME_WAIT_TIMEOUT = 100;
+    private static final int QUIET_IDLE_PERMILLE = 750;
+    private static final int QUIET_BURST_FRAMES = 3;
+    private static final int EMULATION_THREAD_NICE = -8; // THREAD_PRIORITY_URGENT_DISPLAY
 
     private static final String EEPROM_FILE_NAME = "eeprom.bin";
-    private static final CancelCallback EEPROM_CALLBACK = new CancelCallback() {
-        @Override
-        public boolean isCencelled(long length) {
-            return (length >= EEPROM_SIZE);
-        }
-    };
 
     private static final String CAPTURE_DIR_NAME = "ArbyEmulator";
     private static final String CAPTURE_WORK_FILE_NAME = "temp.gif";
     private static final String CAPTURE_FILE_NAME_FORMAT = "yyyyMMddkkmmss'.gif'";
+    private static final String SHOT_FILE_NAME_FORMAT = "yyyyMMddkkmmss'.png'";
+    private static final String SHOT_LARGE_FILE_NAME_FORMAT = "yyyyMMddkkmmss'_x4.png'";
+    private static final int SHOT_LARGE_SCALE = 4;
     private static final File CAPTURE_DIR = new File(
             Environment.getExternalStoragePublicDirectory(Environment.DIRECTORY_PICTURES),
             CAPTURE_DIR_NAME);
     private static final File CAPTURE_WORK_FILE = new File(CAPTURE_DIR, CAPTURE_WORK_FILE_NAME);
 
+    /* Packed frame handed from the emulation thread to the presentation thread */
+    private static class Frame {
+        final byte[]    packed = new byte[Native.FRAME_SIZE];
+        final int[]     leds = new int[LEDS_SIZE];
+        boolean         isContinuous; // the previous frame was handed over too
+    }
+
+    /* Frame queues and running flag of one startEmulation() call */
+    private static class Session {
+        final BlockingQueue<Frame> freeFrames = new ArrayBlockingQueue<Frame>(FRAME_QUEUE_SIZE);
+        final BlockingQueue<Frame> readyFrames = new ArrayBlockingQueue<Frame>(FRAME_QUEUE_SIZE);
+        volatile boolean isRunning = true;
+    }
+
     private MyApplication       mApp;
     private EmulatorScreenView  mEmulatorView;
 
     private Thread      mEmulationThread;
+    private Thread      mPresentationThread;
+    private Session     mSession;
     private boolean     mIsEmulationAvailable;
+    private boolean     mIsBenchmarking;
+    private String      mHexPath;
     private boolean     mIsEmulating;
     private boolean     mIsCharging;
     private boolean     mIsOneShot;
     private boolean     mIsCapturing;
     private int         mFps;
+    private int[]       mPowerStats = new int[POWER_STATS_SIZE];
     private byte[]      mEeprom;
+    private short[]     mScreenPixels = new short[PIXELS_SIZE];
+    private byte[]      mCapturePixels = new byte[PIXELS_SIZE];
     private GifEncoder  mGifEncoder;
+    private StartupTrace mStartupTrace = new StartupTrace();
 
     /*-----------------------------------------------------------------------*/
     /*                              Emulation                                */
@@ -102,6 +134,16 @@ public class ArduboyEmulator {
         mFps = fps;
     }
 
+    /** Guest idle ratio over the last second, in per mille. */
+    public int getGuestIdle() {
+        return mPowerStats[POWER_STAT_GUEST_IDLE];
+    }
+
+    /** Host CPU time of the emulation thread per emulated second, in microseconds. */
+    public int getHostCpuPerEmulatedSecond() {
+        return mPowerStats[POWER_STAT_HOST_CPU_US];
+    }
+
     public synchronized void setCharging(boolean isCharging) {
         mIsCharging = isCharging;
         if (!mIsEmulating && mEmulatorView != null) {
@@ -116,62 +158,132 @@ public class ArduboyEmulator {
     }
 
     public synchronized boolean initializeEmulation(String path) {
+        if (mIsBenchmarking) {
+            return false;
+        }
         if (mIsEmulationAvailable) {
             finishEmulation();
+            mStartupTrace.mark("teardown");
         }
         mIsEmulationAvailable = Native.setup(path, mApp.getEmulationTuning());
-        Native.setRefreshTiming(mApp.getEmulationPostRefresh());
+        mStartupTrace.mark("setup");
+        mStartupTrace.addNativeStages();
+        Native.setHud(mApp.getShowHud());
+        mHexPath = (mIsEmulationAvailable) ? path : null;
         return mIsEmulationAvailable;
     }
 
+    public StartupTrace getStartupTrace() {
+        return mStartupTrace;
+    }
+
+    public String getHexPath() {
+        return mHexPath;
+    }
+
+    /*
+     *  Not synchronized, since it takes seconds. Instead, the native instance is
+     *  marked busy so that nothing else sets it up or tears it down meanwhile.
+     *  The current game is restarted from the beginning afterwards.
+     */
+    public Benchmark.Result runBenchmark(CancelCallback callback) {
+        String path;
+        synchronized (this) {
+            path = mHexPath;
+            if (path == null || mIsEmulating || mIsBenchmarking) {
+                return null;
+            }
+            finishEmulation();
+            mIsBenchmarking = true;
+        }
+        Benchmark.Result result = null;
+        try {
+            result = Benchmark.run(path, mApp.getEmulationTuning(), Benchmark.FRAMES, callback);
+        } finally {
+            synchronized (this) {
+                mIsBenchmarking = false;
+                initializeEmulation(path);
+            }
+        }
+        return result;
+    }
+
     public synchronized boolean startEmulation() {
-        if (!mIsEmulationAvailable) {
+        if (!mIsEmulationAvailable || mIsBenchmarking) {
             return false;
         }
         if (mEmulationThread != null) {
             stopEmulation();
         }
-        final Handler handler = new Handler();
+        // Threads of a previous session that outlived the join keep their own queues
+        final Session session = new Session();
+        for (int i = 0; i < FRAME_QUEUE_SIZE; i++) {
+            session.freeFrames.offer(new Frame());
+        }
+        mSession = session;
         mEmulationThread = new Thread(new Runnable() {
             @Override
             public void run() {
+                mStartupTrace.mark("thread_start");
+                boolean isFirstFrame = true;
                 int fps = mFps;
-                int[] pixels = new int[PIXELS_SIZE];
-                int[] leds = new int[LEDS_SIZE];
                 long baseTime = System.currentTimeMillis();
                 long frames = 0;
-
+                int quietFrames = 0;
+                byte[] lastPacked = new byte[Native.FRAME_SIZE];
+                int[] lastLeds = new int[LEDS_SIZE];
+                EmulatorScreenView lastView = null;
+                boolean lastCharging = false;
+                boolean isHandedOver = false;
+
+                if (mApp.getPinThread()) {
+                    Native.setThreadPriority(EMULATION_THREAD_NICE);
+                    Native.setThreadAffinity(Native.CPU_FASTEST);
+                }
                 Native.setEeprom(mEeprom);
-                while (mIsEmulating) {
+                Native.setFps(fps);
+                mStartupTrace.mark("eeprom");
+                while (session.isRunning) {
                     if (mEmulatorView != null) {
                         boolean[] buttonState = mEmulatorView.updateButtonState();
                         for (int buttonIdx = 0; buttonIdx < Native.BUTTON_MAX; buttonIdx++) {
                             Native.buttonEvent(buttonIdx, buttonState[buttonIdx]);
                         }
                     }
-                    Native.loop(pixels);
-                    Native.getLedState(leds);
-                    if (mEmulatorView != null) {
-                        mEmulatorView.updateScreen(pixels);
-                        mEmulatorView.updateLed(
-                                Color.rgb(leds[LED_RED], leds[LED_GREEN], leds[LED_BLUE]),
-                                (leds[LED_RX] != 0), (leds[LED_TX] != 0), mIsCharging);
-                        mEmulatorView.postInvalidate();
+                    Native.loop();
+                    if (isFirstFrame) {
+                        mStartupTrace.mark("first_loop");
+                        mStartupTrace.finish();
+                        isFirstFrame = false;
                     }
-                    if (mIsOneShot) {
-                        final File file = generateCaptureFile();
-                        if (mGifEncoder.oneShot(file, pixels)) {
-                            handler.post(new Runnable() {
-                                @Override
-                                public void run() {
-                                    notifyCaptured(file, false);
-                                }
-                            });
+                    Frame frame = obtainFrame(session);
+                    boolean isChanged = false;
+                    if (frame != null) {
+                        Native.getFrame(frame.packed);
+                        Native.getLedState(frame.leds);
+                        EmulatorScreenView view = mEmulatorView;
+                        isChanged = (view != lastView || mIsCharging != lastCharging
+                                || !Arrays.equals(frame.packed, lastPacked)
+                                || !Arrays.equals(frame.leds, lastLeds));
+                        // Unchanged frames aren't handed over, so presentation stays asleep
+                        if (isChanged || mIsOneShot || mIsCapturing) {
+                            System.arraycopy(frame.packed, 0, lastPacked, 0, Native.FRAME_SIZE);
+                            System.arraycopy(frame.leds, 0, lastLeds, 0, LEDS_SIZE);
+                            lastView = view;
+                            lastCharging = mIsCharging;
+                            frame.isContinuous = isHandedOver;
+                            isHandedOver = true;
+                            session.readyFrames.offer(frame);
+                        } else {
+                            isHandedOver = false;
+                            session.freeFrames.offer(frame);
                         }
-                        mIsOneShot = false;
                     }
-                    if (mIsCapturing) {
-                        mGifEncoder.addFrame(pixels);
+                    Native.getPowerStats(mPowerStats);
+                    if (!isChanged && mPowerStats[POWER_STAT_FRAME_IDLE] >= QUIET_IDLE_PERMILLE) {
+                        quietFrames++;
+                    } else {
+                        quietFrames = 0;
                     }
                     if (++frames >= fps) {
                         baseTime += ONE_SECOND;
@@ -180,43 +292,145 @@ public class ArduboyEmulator {
                     long currentTime = System.currentTimeMillis();
                     long targetTime = baseTime + frames * ONE_SECOND / fps;
                     if (mFps == fps && currentTime < targetTime) {
-                        try {
-                            Thread.sleep(targetTime - currentTime);
-                        } catch (InterruptedException e) {
-                            // do nothing
+                        // While the guest idles on a static screen, run a few frames ahead
+                        // per wakeup and sleep that much longer
+                        if (quietFrames % QUIET_BURST_FRAMES == 0) {
+                            try {
+                                Thread.sleep(targetTime - currentTime);
+                            } catch (InterruptedException e) {
+                                // do nothing
+                            }
+                        }
+                        if (quietFrames > 0) {
+                            // Burst frames run back to back and the sleep after them is
+                            // deliberate, so the next interval isn't a paced one
+                            Native.restartIntervals();
                         }
                     } else {
-                        fps = mFps;
+                        if (fps != mFps) {
+                            fps = mFps;
+                            Native.setFps(fps);
+                        }
                         baseTime = currentTime;
                         frames = 0;
                     }
                 }
                 Native.getEeprom(mEeprom);
                 saveEeprom();
+                logFrameIntervals("Emulation", Native.INTERVALS_EMULATION);
+                logFrameIntervals("Presentation", Native.INTERVALS_PRESENTATION);
+            }
+        });
+        final Handler handler = new Handler();
+        mPresentationThread = new Thread(new Runnable() {
+            @Override
+            public void run() {
+                byte[] lastPacked = new byte[Native.FRAME_SIZE];
+                EmulatorScreenView lastView = null;
+                while (session.isRunning) {
+                    Frame frame;
+                    try {
+                        frame = session.readyFrames.take();
+                    } catch (InterruptedException e) {
+                        continue; // woken up by stopEmulation()
+                    }
+                    EmulatorScreenView view = mEmulatorView;
+                    if (view != null) {
+                        // A view already showing this frame needn't be converted and uploaded again
+                        if (view != lastView || !Arrays.equals(frame.packed, lastPacked)) {
+                            Native.renderRgb565(frame.packed, mScreenPixels);
+                            view.updateScreen(mScreenPixels);
+                            System.arraycopy(frame.packed, 0, lastPacked, 0, Native.FRAME_SIZE);
+                            lastView = view;
+                        }
+                        int[] leds = frame.leds;
+                        view.updateLed(
+                                Color.rgb(leds[LED_RED], leds[LED_GREEN], leds[LED_BLUE]),
+                                (leds[LED_RX] != 0), (leds[LED_TX] != 0), mIsCharging);
+                        view.postInvalidate();
+                        Native.notePresented(frame.isContinuous);
+                    }
+                    if (mIsOneShot) {
+                        final File file = generateCaptureFile(SHOT_FILE_NAME_FORMAT);
+                        final File largeFile = (mApp.getLargeShot())
+                                ? generateCaptureFile(SHOT_LARGE_FILE_NAME_FORMAT) : null;
+                        if (Native.savePng(frame.packed, file.getAbsolutePath(), 1) &&
+                                (largeFile == null || Native.savePng(frame.packed,
+                                        largeFile.getAbsolutePath(), SHOT_LARGE_SCALE))) {
+                            handler.post(new Runnable() {
+                                @Override
+                                public void run() {
+                                    if (largeFile != null) {
+                                        scanCapturedFile(largeFile);
+                                    }
+                                    notifyCaptured(file, false);
+                                }
+                            });
+                        }
+                        mIsOneShot = false;
+                    }
+                    if (mIsCapturing) {
+                        Native.renderLuma(frame.packed, mCapturePixels);
+                        mGifEncoder.addFrame(mCapturePixels);
+                    }
+                    session.freeFrames.offer(frame);
+                }
             }
         });
-        if (mEmulationThread == null) {
-            return false;
-        }
         mIsEmulating = true;
         mEmulationThread.start();
+        mPresentationThread.start();
         return true;
     }
 
     public synchronized void stopEmulation() {
         if (mEmulationThread != null) {
             mIsEmulating = false;
+            mSession.isRunning = false;
+            mPresentationThread.interrupt();
             try {
                 mEmulationThread.join(ONE_SECOND);
+                mPresentationThread.join(ONE_SECOND);
             } catch (InterruptedException e) {
                 e.printStackTrace();
             }
             mEmulationThread = null;
+            mPresentationThread = null;
+        }
+    }
+
+    private void logFrameIntervals(String name, int which) {
+        int[] stats = new int[Native.INTERVAL_STATS_SIZE];
+        if (Native.getFrameIntervals(which, stats)) {
+            Log.i(LOG_TAG, String.format(
+                    "%s intervals: %d samples, p50 %dus, p95 %dus, p99 %dus, %d late, %d dropped",
+                    name, stats[Native.INTERVAL_STAT_SAMPLES], stats[Native.INTERVAL_STAT_P50_US],
+                    stats[Native.INTERVAL_STAT_P95_US], stats[Native.INTERVAL_STAT_P99_US],
+                    stats[Native.INTERVAL_STAT_LATE], stats[Native.INTERVAL_STAT_DROPPED]));
+        }
+    }
+
+    private Frame obtainFrame(Session session) {
+        Frame frame = session.freeFrames.poll();
+        while (frame == null && session.isRunning) {
+            // Presentation is falling behind, so drop its oldest pending frame
+            // unless it is being recorded, where every frame must reach the encoder
+            if (!mIsCapturing) {
+                frame = session.readyFrames.poll();
+            }
+            if (frame == null) {
+                try {
+                    frame = session.freeFrames.poll(FRAME_WAIT_TIMEOUT, TimeUnit.MILLISECONDS);
+                } catch (InterruptedException e) {
+                    // do nothing
+                }
+            }
         }
+        return frame;
     }
 
     public synchronized void finishEmulation() {
-        if (mIsEmulationAvailable) {
+        if (mIsEmulationAvailable && !mIsBenchmarking) {
             stopEmulation();
             Native.teardown();
             mIsEmulationAvailable = false;
@@ -283,13 +497,13 @@ public class ArduboyEmulator {
         }
     }
 
-    private boolean inputEeprom(InputStream in, boolean isInternal)
+    private boolean inputEeprom(FileInputStream in, boolean isInternal)
             throws FileNotFoundException, IOException {
         try {
-            ByteArrayOutputStream out = new ByteArrayOutputStream(EEPROM_SIZE);
-            long length = Utils.transferBytes(in, out, EEPROM_CALLBACK);
+            byte[] eeprom = new byte[EEPROM_SIZE];
+            int length = Utils.readBytes(in, eeprom);
             if (length >= EEPROM_SIZE) {
-                mEeprom = out.toByteArray();
+                mEeprom = eeprom;
                 return true;
             } else if (isInternal) {
                 defaultEeprom();
@@ -307,8 +521,8 @@ public class ArduboyEmulator {
         }
     }
 
-    private boolean outputEeprom(OutputStream out) throws IOException {
-        long length = Utils.transferBytes(new ByteArrayInputStream(mEeprom), out, EEPROM_CALLBACK);
+    private boolean outputEeprom(FileOutputStream out) throws IOException {
+        int length = Utils.writeBytes(out, mEeprom);
         return (length >= EEPROM_SIZE);
     }
 
@@ -350,7 +564,7 @@ public class ArduboyEmulator {
             return false;
         }
         mIsCapturing = false;
-        File file = generateCaptureFile();
+        File file = generateCaptureFile(CAPTURE_FILE_NAME_FORMAT);
         if (mGifEncoder.finish(file)) {
             notifyCaptured(file, true);
             return true;
@@ -372,14 +586,18 @@ public class ArduboyEmulator {
 
     }
 
-    private File generateCaptureFile() {
+    private File generateCaptureFile(String format) {
         ensureCaptureDir();
         return new File(CAPTURE_DIR, DateFormat.format(
-                CAPTURE_FILE_NAME_FORMAT, Calendar.getInstance()).toString());
+                format, Calendar.getInstance()).toString());
     }
 
-    private void notifyCaptured(File file, boolean isMovie) {
+    private void scanCapturedFile(File file) {
         MediaScannerConnection.scanFile(mApp, new String[] { file.getAbsolutePath() }, null, null);
+    }
+
+    private void notifyCaptured(File file, boolean isMovie) {
+        scanCapturedFile(file);
         int stringId = (isMovie) ? R.string.messageCaptureMovie : R.string.messageCaptureShot;
         String message = String.format(mApp.getString(stringId), file.getName());
         Utils.showToast(mApp, message);
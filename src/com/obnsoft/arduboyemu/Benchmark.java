@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+package com.obnsoft.arduboyemu;
+
+import java.io.File;
+
+import org.json.JSONException;
+import org.json.JSONObject;
+
+import com.obnsoft.arduboyemu.Utils.CancelCallback;
+
+import android.os.Build;
+
+/**
+ * Runs a game headlessly and unthrottled, with the same JNI calls per frame
+ * as emulation, and measures where the host time goes.
+ */
+public class Benchmark {
+
+    public static final int FRAMES = 3600;
+
+    private static final int BENCH_STAT_CORE_NS    = 0;
+    private static final int BENCH_STAT_PACK_NS    = 1;
+    private static final int BENCH_STAT_RENDER_NS  = 2;
+    private static final int BENCH_STAT_CYCLES     = 3;
+    private static final int BENCH_STATS_SIZE      = 4;
+
+    private static final double NANOS_PER_SECOND = 1000000000.0;
+    private static final double NANOS_PER_MICRO = 1000.0;
+
+    public static class Result {
+        public String   romName;
+        public int      frames;
+        public long     wallNanos;
+        public long     cycles;
+        public long     coreNanos;
+        public long     packNanos;
+        public long     renderNanos;
+        public long     jniNanos;
+        public StartupTrace startupTrace;
+
+        public double getEmulatedMhz() {
+            return cycles * NANOS_PER_SECOND / wallNanos / 1000000.0;
+        }
+
+        public double getFps() {
+            return frames * NANOS_PER_SECOND / wallNanos;
+        }
+
+        public double getMicrosPerFrame(long nanos) {
+            return nanos / NANOS_PER_MICRO / frames;
+        }
+
+        public JSONObject toJson() throws JSONException {
+            JSONObject stagesJson = new JSONObject();
+            stagesJson.put("core", getMicrosPerFrame(coreNanos));
+            stagesJson.put("pack", getMicrosPerFrame(packNanos));
+            stagesJson.put("render", getMicrosPerFrame(renderNanos));
+            stagesJson.put("jni", getMicrosPerFrame(jniNanos));
+            JSONObject deviceJson = new JSONObject();
+            deviceJson.put("manufacturer", Build.MANUFACTURER);
+            deviceJson.put("model", Build.MODEL);
+            deviceJson.put("abi", Build.CPU_ABI);
+            deviceJson.put("sdk", Build.VERSION.SDK_INT);
+            JSONObject json = new JSONObject();
+            json.put("device", deviceJson);
+            json.put("rom", romName);
+            json.put("frames", frames);
+            json.put("wallMs", wallNanos / 1000000.0);
+            json.put("emulatedMhz", getEmulatedMhz());
+            json.put("fps", getFps());
+            json.put("stageUsPerFrame", stagesJson);
+            json.put("startupMs", startupTrace.toJson());
+            return json;
+        }
+    }
+
+    /**
+     * Sets up a fresh instance from the hex file and runs it for the given
+     * frames. The caller must re-initialize emulation afterwards.
+     */
+    public static Result run(String hexPath, boolean isTuned, int frames,
+            CancelCallback callback) {
+        StartupTrace startupTrace = new StartupTrace();
+        startupTrace.begin();
+        if (!Native.setup(hexPath, isTuned)) {
+            return null;
+        }
+        startupTrace.mark("setup");
+        startupTrace.addNativeStages();
+        Native.setHud(false);
+        Native.setFps(0);
+        byte[] packed = new byte[Native.FRAME_SIZE];
+        short[] pixels = new short[ArduboyEmulator.SCREEN_WIDTH * ArduboyEmulator.SCREEN_HEIGHT];
+        long[] stats = new long[BENCH_STATS_SIZE];
+
+        long startTime = System.nanoTime();
+        int frame;
+        for (frame = 0; frame < frames; frame++) {
+            if (callback != null && callback.isCencelled(frame)) {
+                break;
+            }
+            if (!Native.loop()) {
+                break;
+            }
+            if (frame == 0) {
+                startupTrace.mark("first_loop");
+                startupTrace.finish();
+            }
+            Native.getFrame(packed);
+            Native.renderRgb565(packed, pixels);
+        }
+        long wallNanos = System.nanoTime() - startTime;
+        Native.getBenchStats(stats);
+        Native.teardown();
+        if (frame < frames) {
+            return null;
+        }
+
+        Result result = new Result();
+        result.startupTrace = startupTrace;
+        result.romName = new File(hexPath).getName();
+        result.frames = frames;
+        result.wallNanos = wallNanos;
+        result.cycles = stats[BENCH_STAT_CYCLES];
+        result.coreNanos = stats[BENCH_STAT_CORE_NS];
+        result.packNanos = stats[BENCH_STAT_PACK_NS];
+        result.renderNanos = stats[BENCH_STAT_RENDER_NS];
+        result.jniNanos = Math.max(0, wallNanos
+                - result.coreNanos - result.packNanos - result.renderNanos);
+        return result;
+    }
+}
@@ -18,6 +18,8 @@
 
 package com.obnsoft.arduboyemu;
 
+import java.nio.ShortBuffer;
+
 import android.annotation.SuppressLint;
 import android.content.Context;
 import android.graphics.Bitmap;
@@ -151,7 +153,7 @@ public class EmulatorScreenView extends View {
         setFocusable(false);
 
         mSkin = new DrawObject(R.drawable.skin, false);
-        mScreen = new DrawObject(Bitmap.createBitmap(SCREEN_W, SCREEN_H, Bitmap.Config.ARGB_8888),
+        mScreen = new DrawObject(Bitmap.createBitmap(SCREEN_W, SCREEN_H, Bitmap.Config.RGB_565),
                 null, new Paint(0)); // No ANTI_ALIAS_FLAG, No FILTER_BITMAP_FLAG
         mLedRgbFlare = new DrawObject(R.drawable.flare, true);
         mLedUartFlare = new DrawObject[LED_UART_ID_MAX];
@@ -284,10 +286,10 @@ public class EmulatorScreenView extends View {
         return mButtonState;
     }
 
-    public void updateScreen(int[] pixels) {
+    public void updateScreen(short[] pixels) {
         synchronized (mScreen) {
             if (!mScreen.bitmap.isRecycled()) {
-                mScreen.bitmap.setPixels(pixels, 0, SCREEN_W, 0, 0, SCREEN_W, SCREEN_H);
+                mScreen.bitmap.copyPixelsFromBuffer(ShortBuffer.wrap(pixels));
             }
         }
     }
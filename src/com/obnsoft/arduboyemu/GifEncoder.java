@@ -71,7 +71,7 @@ public class GifEncoder {
      *
      * @return true if successful.
      */
-    public boolean addFrame(int[] pixels) {
+    public boolean addFrame(byte[] pixels) {
         if (!mIsStarted || pixels == null || pixels.length != PIXELS) {
             return false;
         }
@@ -120,37 +120,13 @@ public class GifEncoder {
         return ret;
     }
 
-    public boolean oneShot(File file, int[] pixels) {
-        if (pixels == null || pixels.length != PIXELS) {
-            return false;
-        }
-        boolean ret = false;
-        try {
-            FileOutputStream out = new FileOutputStream(file);
-            writeHeader(out); // header
-            writeLSD(out); // logical screen descriptor
-            writePalette(out); // global color table
-            byte[] indexedPixels = analyzePixels(pixels); // build map pixels
-            writeImageBlock(out, indexedPixels); // write image block
-            writeTrailer(out); // gif trailer
-            out.close();
-            ret = true;
-        } catch (IOException e) {
-            e.printStackTrace();
-            file.delete();
-        }
-        return ret;
-    }
-
     /**
      * Analyzes image colors and creates color map.
      */
-    private byte[] analyzePixels(int[] pixels) {
+    private byte[] analyzePixels(byte[] pixels) {
         byte[] indexedPixels = new byte[PIXELS];
         for (int i = 0; i < PIXELS; i++) {
-            int c = pixels[i];
-            int r = (c >> 16) & 0xFF, g = (c >> 8) & 0xFF, b = c & 0xFF;
-            boolean isWhite = ((306 * r + 601 * g + 117 * b) >= 512);
+            boolean isWhite = (pixels[i] != 0); // 8-bit luminance
             indexedPixels[i] = (byte) (isWhite ? 1 : 0);
         }
         return indexedPixels;
@@ -198,6 +198,16 @@ public class MainActivity extends Activity {
     /*-----------------------------------------------------------------------*/
 
     private void startEmulation(String path) {
+        startEmulation(path, false);
+    }
+
+    private void startEmulation(String path, boolean isDownloaded) {
+        final StartupTrace trace = mArduboyEmulator.getStartupTrace();
+        if (isDownloaded && trace.isActive()) {
+            trace.skip(); // confirmation after download
+        } else {
+            trace.begin();
+        }
         if (path.toLowerCase(Locale.getDefault()).endsWith(FilePickerActivity.EXT_ARDUBOY)) {
             File outFile = Utils.generateTempFile(mApp, FLASH_WORK_FILE_NAME);
             if (ArduboyUtils.extractHexFromArduboy(new File(path), outFile)) {
@@ -206,11 +216,13 @@ public class MainActivity extends Activity {
                 outFile.delete();
                 path = null;
             }
+            trace.mark("extract");
         }
         if (path != null && mArduboyEmulator.initializeEmulation(path)) {
             mCurrentPath = path;
             mArduboyEmulator.startEmulation();
         } else {
+            trace.cancel();
             Utils.showToast(this, R.string.messageEmulateFailed);
         }
     }
@@ -219,6 +231,8 @@ public class MainActivity extends Activity {
         String action = intent.getAction();
         Uri uri = intent.getData();
         if (Intent.ACTION_VIEW.equals(action) && uri != null) {
+            final StartupTrace trace = mArduboyEmulator.getStartupTrace();
+            trace.begin();
             Utils.downloadFile(this, uri, new ResultHandler() {
                 @Override
                 public void handleResult(Result result, File file) {
@@ -228,12 +242,15 @@ public class MainActivity extends Activity {
                         // go to following code
                     default:
                     case CANCELLED:
+                        trace.cancel();
                         file.delete();
                         break;
                     case SUCCEEDED:
+                        trace.mark("download");
                         final String path = file.getAbsolutePath();
                         if (path.toLowerCase(Locale.getDefault())
                                 .endsWith(FilePickerActivity.EXT_EEPROM)) {
+                            trace.cancel();
                             Utils.showMessageDialog(MainActivity.this, 0, R.string.menuEeprom,
                                     R.string.messageConfirmLoad, new OnClickListener() {
                                         @Override
@@ -246,7 +263,7 @@ public class MainActivity extends Activity {
                                     R.string.messageConfirmLoad, new OnClickListener() {
                                         @Override
                                         public void onClick(DialogInterface dialog, int which) {
-                                            startEmulation(path);
+                                            startEmulation(path, true);
                                         }
                             });
                         }
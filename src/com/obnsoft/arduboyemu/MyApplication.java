@@ -35,16 +35,20 @@ public class MyApplication extends Application {
 
     private static final String PREFS_KEY_TOOLBAR       = "toolbar";
     private static final String PREFS_KEY_FPS           = "fps";
-    private static final String PREFS_KEY_REFRESH       = "refresh";
     private static final String PREFS_KEY_TUNING        = "tuning";
+    private static final String PREFS_KEY_HUD           = "hud";
+    private static final String PREFS_KEY_PIN_THREAD    = "pin_thread";
+    private static final String PREFS_KEY_LARGE_SHOT    = "large_shot";
     private static final String PREFS_KEY_CONFIRMQUIT   = "confirm_quit";
     private static final String PREFS_KEY_PATH_FLASH    = "path_flash";
     private static final String PREFS_KEY_PATH_EEPROM   = "path_eeprom";
 
     private static final boolean PREFS_DEFAULT_TOOLBAR  = false;
     private static final String PREFS_DEFAULT_FPS       = "60";
-    private static final boolean PREFS_DEFAULT_REFRESH  = false;
     private static final boolean PREFS_DEFAULT_TUNING   = false;
+    private static final boolean PREFS_DEFAULT_HUD      = false;
+    private static final boolean PREFS_DEFAULT_PIN_THREAD = false;
+    private static final boolean PREFS_DEFAULT_LARGE_SHOT = false;
     private static final boolean PREFS_DEFAULT_CONFIRMQUIT = true;
 
     private ArduboyEmulator     mArduboyEmulator;
@@ -115,14 +119,22 @@ public class MyApplication extends Application {
         return putStringToSharedPreferences(PREFS_KEY_FPS, ary[itemPos]);
     }
 
-    public boolean getEmulationPostRefresh() {
-        return getSharedPreferences().getBoolean(PREFS_KEY_REFRESH, PREFS_DEFAULT_REFRESH);
-    }
-
     public boolean getEmulationTuning() {
         return getSharedPreferences().getBoolean(PREFS_KEY_TUNING, PREFS_DEFAULT_TUNING);
     }
 
+    public boolean getShowHud() {
+        return getSharedPreferences().getBoolean(PREFS_KEY_HUD, PREFS_DEFAULT_HUD);
+    }
+
+    public boolean getPinThread() {
+        return getSharedPreferences().getBoolean(PREFS_KEY_PIN_THREAD, PREFS_DEFAULT_PIN_THREAD);
+    }
+
+    public boolean getLargeShot() {
+        return getSharedPreferences().getBoolean(PREFS_KEY_LARGE_SHOT, PREFS_DEFAULT_LARGE_SHOT);
+    }
+
     public boolean getConfirmQuit() {
         return getSharedPreferences().getBoolean(PREFS_KEY_CONFIRMQUIT, PREFS_DEFAULT_CONFIRMQUIT);
     }
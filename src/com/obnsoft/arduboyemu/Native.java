@@ -28,6 +28,22 @@ public class Native {
     public static final int BUTTON_B    = 5;
     public static final int BUTTON_MAX  = 6;
 
+    public static final int FRAME_SIZE  = 1076;
+
+    public static final int CPU_ANY     = -1;
+    public static final int CPU_FASTEST = -2;
+
+    public static final int INTERVALS_EMULATION     = 0;
+    public static final int INTERVALS_PRESENTATION  = 1;
+
+    public static final int INTERVAL_STAT_SAMPLES   = 0;
+    public static final int INTERVAL_STAT_P50_US    = 1;
+    public static final int INTERVAL_STAT_P95_US    = 2;
+    public static final int INTERVAL_STAT_P99_US    = 3;
+    public static final int INTERVAL_STAT_LATE      = 4;
+    public static final int INTERVAL_STAT_DROPPED   = 5;
+    public static final int INTERVAL_STATS_SIZE     = 6;
+
     static {
         System.loadLibrary("ArduboyEmulatorNative");
     }
@@ -35,9 +51,23 @@ public class Native {
     public static native boolean setup(String hexFilePath, boolean isTuned);
     public static native boolean getEeprom(byte[] ary);
     public static native boolean setEeprom(byte[] ary);
-    public static native boolean setRefreshTiming(boolean isPostpone);
+    public static native boolean setHud(boolean isEnabled);
+    public static native boolean setFps(int fps);
+    public static native boolean setThreadPriority(int nice);
+    public static native boolean setThreadAffinity(int cpu);
+    public static native int getCoreMigrations();
     public static native boolean buttonEvent(int key, boolean isPress);
-    public static native boolean loop(int[] pixels);
+    public static native boolean loop();
+    public static native boolean getFrame(byte[] frame);
+    public static native boolean renderRgb565(byte[] frame, short[] pixels);
+    public static native boolean renderLuma(byte[] frame, byte[] pixels);
+    public static native boolean savePng(byte[] frame, String path, int scale);
+    public static native boolean getPowerStats(int[] stats);
+    public static native boolean getBenchStats(long[] stats);
+    public static native boolean getStartupTimes(long[] stageNanos);
+    public static native boolean restartIntervals();
+    public static native boolean notePresented(boolean isContinuous);
+    public static native boolean getFrameIntervals(int which, int[] stats);
     public static native boolean getLedState(int[] leds);
     public static native void teardown();
 }
@@ -18,6 +18,13 @@
 
 package com.obnsoft.arduboyemu;
 
+import org.json.JSONException;
+
+import com.obnsoft.arduboyemu.MyAsyncTaskWithDialog.Result;
+import com.obnsoft.arduboyemu.Utils.CancelCallback;
+
+import android.app.AlertDialog;
+import android.app.ProgressDialog;
 import android.content.DialogInterface;
 import android.content.Intent;
 import android.content.SharedPreferences;
@@ -37,8 +44,9 @@ import android.view.MenuItem;
 public class SettingsActivity extends PreferenceActivity
         implements OnSharedPreferenceChangeListener {
 
-    private static final String PREFS_KEY_REFRESH   = "refresh";
     private static final String PREFS_KEY_TUNING    = "tuning";
+    private static final String PREFS_KEY_HUD       = "hud";
+    private static final String PREFS_KEY_BENCHMARK = "benchmark";
     private static final String PREFS_KEY_ABOUT     = "about";
     private static final String PREFS_KEY_LICENSE   = "license";
     private static final String PREFS_KEY_WEBSITES  = "websites";
@@ -71,7 +79,9 @@ public class SettingsActivity extends PreferenceActivity
 
         @Override
         public boolean onPreferenceClick(Preference pref) {
-            if (PREFS_KEY_ABOUT.equals(pref.getKey())) {
+            if (PREFS_KEY_BENCHMARK.equals(pref.getKey())) {
+                runBenchmark();
+            } else if (PREFS_KEY_ABOUT.equals(pref.getKey())) {
                 Utils.showVersion(SettingsActivity.this);
             } else if (PREFS_KEY_LICENSE.equals(pref.getKey())) {
                 Intent intent = new Intent(Intent.ACTION_VIEW, URI_GPL3);
@@ -169,8 +179,8 @@ public class SettingsActivity extends PreferenceActivity
     @Override
     public void onSharedPreferenceChanged(SharedPreferences prefs, String key) {
         mFragment.setSummary(key);
-        if (PREFS_KEY_REFRESH.equals(key)) {
-            Native.setRefreshTiming(prefs.getBoolean(PREFS_KEY_REFRESH, false));
+        if (PREFS_KEY_HUD.equals(key)) {
+            Native.setHud(prefs.getBoolean(PREFS_KEY_HUD, false));
         }
         if (PREFS_KEY_TUNING.equals(key)) {
             Utils.showMessageDialog(this, android.R.drawable.ic_dialog_alert, R.string.prefsTuning,
@@ -180,6 +190,71 @@ public class SettingsActivity extends PreferenceActivity
 
     /*-----------------------------------------------------------------------*/
 
+    private void runBenchmark() {
+        final ArduboyEmulator emulator = mApp.getArduboyEmulator();
+        if (emulator.getHexPath() == null) {
+            Utils.showToast(this, R.string.messageBenchmarkNoGame);
+            return;
+        }
+        MyAsyncTaskWithDialog.ITask task = new MyAsyncTaskWithDialog.ITask() {
+            private volatile boolean mIsCancelled = false;
+            private Benchmark.Result mResult;
+            @Override
+            public Boolean task(ProgressDialog dialog) {
+                mResult = emulator.runBenchmark(new CancelCallback() {
+                    @Override
+                    public boolean isCencelled(long length) {
+                        return mIsCancelled;
+                    }
+                });
+                return (mResult != null);
+            }
+            @Override
+            public void cancel() {
+                mIsCancelled = true;
+            }
+            @Override
+            public void post(Result result) {
+                if (result == Result.SUCCEEDED) {
+                    showBenchmarkResult(mResult);
+                } else if (result == Result.FAILED) {
+                    Utils.showToast(SettingsActivity.this, R.string.messageBenchmarkFailed);
+                }
+            }
+        };
+        MyAsyncTaskWithDialog.execute(this, true, R.string.messageBenchmarking, task);
+    }
+
+    private void showBenchmarkResult(Benchmark.Result result) {
+        String message = String.format(getString(R.string.messageBenchmarkResult),
+                result.romName, result.frames, result.getEmulatedMhz(), result.getFps(),
+                result.getMicrosPerFrame(result.coreNanos),
+                result.getMicrosPerFrame(result.packNanos),
+                result.getMicrosPerFrame(result.renderNanos),
+                result.getMicrosPerFrame(result.jniNanos));
+        final String json;
+        try {
+            json = result.toJson().toString(2);
+        } catch (JSONException e) {
+            e.printStackTrace();
+            return;
+        }
+        new AlertDialog.Builder(this)
+                .setTitle(R.string.prefsBenchmark)
+                .setMessage(message)
+                .setPositiveButton(android.R.string.ok, null)
+                .setNeutralButton(R.string.menuExportJson, new DialogInterface.OnClickListener() {
+                    @Override
+                    public void onClick(DialogInterface dialog, int which) {
+                        Intent intent = new Intent(Intent.ACTION_SEND);
+                        intent.setType("application/json");
+                        intent.putExtra(Intent.EXTRA_TEXT, json);
+                        startActivity(Intent.createChooser(intent, null));
+                    }
+                })
+                .show();
+    }
+
     private void showUrlList() {
         final String[] items = getResources().getStringArray(R.array.bookmarkArray);
         DialogInterface.OnClickListener listener = new DialogInterface.OnClickListener() {
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018 OBONO
+ * http://d.hatena.ne.jp/OBONO/
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+package com.obnsoft.arduboyemu;
+
+import java.util.LinkedHashMap;
+import java.util.Map;
+
+import org.json.JSONException;
+import org.json.JSONObject;
+
+import android.util.Log;
+
+/**
+ * Times the stages from an intent or a file selection to the first emulated
+ * frame with the monotonic clock.
+ */
+public class StartupTrace {
+
+    private static final String LOG_TAG = "ArbyEmulator";
+    private static final String STAGE_TOTAL = "total";
+    private static final String[] NATIVE_STAGE_NAMES = {
+        "setup.make_mcu", "setup.init", "setup.load_hex", "setup.display", "setup.peripherals",
+    };
+    private static final double NANOS_PER_MILLI = 1000000.0;
+
+    private final Map<String, Long> mStageNanos = new LinkedHashMap<String, Long>();
+    private boolean mIsActive;
+    private long    mStartTime;
+    private long    mLastTime;
+    private long    mSkippedNanos;
+
+    /** Starts a new record, dropping any left unfinished. */
+    public synchronized void begin() {
+        mStageNanos.clear();
+        mStartTime = mLastTime = System.nanoTime();
+        mSkippedNanos = 0;
+        mIsActive = true;
+    }
+
+    public synchronized boolean isActive() {
+        return mIsActive;
+    }
+
+    /** Drops the record in progress, e.g. when loading failed. */
+    public synchronized void cancel() {
+        mIsActive = false;
+    }
+
+    /** Ends the current stage. */
+    public synchronized void mark(String stage) {
+        if (mIsActive) {
+            long now = System.nanoTime();
+            mStageNanos.put(stage, now - mLastTime);
+            mLastTime = now;
+        }
+    }
+
+    /** Ends a wait for the user, which isn't part of the total. */
+    public synchronized void skip() {
+        if (mIsActive) {
+            long now = System.nanoTime();
+            mSkippedNanos += now - mLastTime;
+            mLastTime = now;
+        }
+    }
+
+    /** Adds the breakdown of the last Native.setup() call. */
+    public synchronized void addNativeStages() {
+        long[] stageNanos = new long[NATIVE_STAGE_NAMES.length];
+        if (mIsActive && Native.getStartupTimes(stageNanos)) {
+            for (int i = 0; i < NATIVE_STAGE_NAMES.length; i++) {
+                mStageNanos.put(NATIVE_STAGE_NAMES[i], stageNanos[i]);
+            }
+        }
+    }
+
+    /** Completes the record and reports it to logcat. */
+    public synchronized void finish() {
+        if (mIsActive) {
+            mStageNanos.put(STAGE_TOTAL, System.nanoTime() - mStartTime - mSkippedNanos);
+            mIsActive = false;
+            Log.i(LOG_TAG, "Startup: " + toString());
+        }
+    }
+
+    public synchronized JSONObject toJson() throws JSONException {
+        JSONObject json = new JSONObject();
+        for (Map.Entry<String, Long> entry : mStageNanos.entrySet()) {
+            json.put(entry.getKey(), entry.getValue() / NANOS_PER_MILLI);
+        }
+        return json;
+    }
+
+    @Override
+    public synchronized String toString() {
+        StringBuilder sb = new StringBuilder();
+        for (Map.Entry<String, Long> entry : mStageNanos.entrySet()) {
+            if (sb.length() > 0) {
+                sb.append(", ");
+            }
+            sb.append(String.format("%s %.2fms", entry.getKey(),
+                    entry.getValue() / NANOS_PER_MILLI));
+        }
+        return sb.toString();
+    }
+}
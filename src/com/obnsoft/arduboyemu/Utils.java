@@ -20,11 +20,14 @@ package com.obnsoft.arduboyemu;
 
 import java.io.BufferedReader;
 import java.io.File;
+import java.io.FileInputStream;
 import java.io.FileOutputStream;
 import java.io.IOException;
 import java.io.InputStream;
 import java.io.InputStreamReader;
 import java.io.OutputStream;
+import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
 
 import org.apache.http.HttpResponse;
 import org.apache.http.client.HttpClient;
@@ -66,7 +69,9 @@ public class Utils {
     private static final String SCHEME_CONTENT  = "content";
     private static final String SCHEME_ARDUBOY  = "arduboy";
 
-    private static final int BUFFER_SIZE = 1024 * 1024; // 1MiB
+    private static final int BUFFER_SIZE = 64 * 1024; // 64KiB
+
+    private static byte[] sBuffer;
 
     public static void showCustomDialog(
             Context context, int iconId, int titleId, View view, final OnClickListener listener) {
@@ -167,19 +172,109 @@ public class Utils {
 
     public static long transferBytes(InputStream in, OutputStream out, CancelCallback callback)
             throws IOException {
-        byte[]  buffer = new byte[BUFFER_SIZE];
+        if (in instanceof FileInputStream && out instanceof FileOutputStream) {
+            long length = transferFileBytes((FileInputStream) in, (FileOutputStream) out, callback);
+            if (length >= 0) {
+                return length;
+            }
+        }
+        byte[]  buffer = obtainBuffer();
         long    length = 0;
         int     readLength;
-        while (!(callback != null && callback.isCencelled(length))
-                && (readLength = in.read(buffer)) >= 0) {
-            out.write(buffer, 0, readLength);
-            length += readLength;
+        try {
+            while (!(callback != null && callback.isCencelled(length))
+                    && (readLength = in.read(buffer)) >= 0) {
+                out.write(buffer, 0, readLength);
+                length += readLength;
+            }
+        } finally {
+            recycleBuffer(buffer);
         }
         out.close(); 
         in.close();
         return length;
     }
 
+    /*
+     *  Copy between files in the kernel, or return -1 with both streams left open
+     *  if the input isn't a regular file or the kernel won't transfer it.
+     */
+    private static long transferFileBytes(FileInputStream in, FileOutputStream out,
+            CancelCallback callback) throws IOException {
+        FileChannel inChannel = in.getChannel();
+        FileChannel outChannel = out.getChannel();
+        long position, size;
+        try {
+            position = inChannel.position();
+            size = inChannel.size();
+        } catch (IOException e) {
+            return -1; // pipe or socket
+        }
+        if (size <= position) {
+            return -1; // pipes may report zero size, so let the stream path find out
+        }
+        long length = 0;
+        boolean isCancelled = false;
+        while (position < size) {
+            if (callback != null && callback.isCencelled(length)) {
+                isCancelled = true;
+                break;
+            }
+            long transferLength = inChannel.transferTo(
+                    position, Math.min(BUFFER_SIZE, size - position), outChannel);
+            if (transferLength <= 0) {
+                break;
+            }
+            position += transferLength;
+            length += transferLength;
+        }
+        if (length == 0 && !isCancelled) {
+            return -1; // nothing written yet, so the stream path can start over
+        }
+        out.close();
+        in.close();
+        if (position < size && !isCancelled) {
+            throw new IOException("Short copy: " + position + " of " + size + " bytes");
+        }
+        return length;
+    }
+
+    public static int readBytes(FileInputStream in, byte[] ary) throws IOException {
+        FileChannel channel = in.getChannel();
+        ByteBuffer buffer = ByteBuffer.wrap(ary);
+        try {
+            while (buffer.hasRemaining() && channel.read(buffer) >= 0) {
+                // continue
+            }
+        } finally {
+            in.close();
+        }
+        return buffer.position();
+    }
+
+    public static int writeBytes(FileOutputStream out, byte[] ary) throws IOException {
+        FileChannel channel = out.getChannel();
+        ByteBuffer buffer = ByteBuffer.wrap(ary);
+        try {
+            while (buffer.hasRemaining()) {
+                channel.write(buffer);
+            }
+        } finally {
+            out.close();
+        }
+        return buffer.position();
+    }
+
+    private static synchronized byte[] obtainBuffer() {
+        byte[] buffer = sBuffer;
+        sBuffer = null;
+        return (buffer != null) ? buffer : new byte[BUFFER_SIZE];
+    }
+
+    private static synchronized void recycleBuffer(byte[] buffer) {
+        sBuffer = buffer;
+    }
+
     public static void downloadFile(final Context context, Uri uri, final ResultHandler handler) {
         final Uri actualUri;
         final boolean isNet;